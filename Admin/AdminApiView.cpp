@@ -0,0 +1,10 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "AdminApiView.h"
@@ -0,0 +1,93 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef ADMINAPIVIEW_H
+#define ADMINAPIVIEW_H
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "CoreException.h"
+#include "API/IBaseApiView.h"
+#include "API/Health/HealthApiModel.h"
+#include "API/Session/SessionApiModel.h"
+
+#define ADMIN_DEFAULT_SESSION_MEASURE "lastSearchMs"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+// GET admin/sessions[/<measure>[/<count>]] - the sessions using most of a resource, see SessionUsage::Measures
+// GET admin/clients - rate limits and consumption of every client
+// POST admin/drain - starts a drain, optional body { "timeoutSeconds" }, see HealthApiModel
+// Served on the loopback admin listener only, see AdminSettings. Sessions are named by SessionApiModel::SessionId.
+class AdminApiView : public IBaseApiView
+{
+private:
+    SessionApiModel& sessionModel_;
+    HealthApiModel& healthModel_;
+
+public:
+    AdminApiView(SessionApiModel& sessionModel, HealthApiModel& healthModel)
+        : sessionModel_(sessionModel)
+        , healthModel_(healthModel)
+    {
+    }
+
+    QString Name() override { return "AdminApiView"; }
+    QStringList Endpoints() override { return { "admin/<arg>", "admin/<arg>/<arg>", "admin/<arg>/<arg>/<arg>" }; }
+
+    QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::All; }
+
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments& arguments) override
+    {
+        if (arguments[0] == "sessions")
+        {
+            auto measure = arguments.size() > 1 ? arguments[1] : QString(ADMIN_DEFAULT_SESSION_MEASURE);
+
+            bool isCountValid = true;
+            auto count = arguments.size() > 2 ? arguments[2].toInt(&isCountValid) : SESSION_TOP_DEFAULT_COUNT;
+
+            if (isCountValid == false)
+            {
+                throw CoreException("Invalid sessions count: " + arguments[2]);
+            }
+
+            return sessionModel_.TopSessions(measure, count);
+        }
+
+        if (arguments[0] == "clients")
+        {
+            return sessionModel_.Clients().ToJson();
+        }
+
+        throw CoreException(QString("Unknown admin resource: %1").arg(arguments[0]));
+    }
+
+    QJsonObject Post(const QHttpServerRequest& request, const RouteArguments& arguments) override
+    {
+        if (arguments[0] != "drain" || arguments.size() > 1)
+        {
+            throw CoreException(QString("Unknown admin action: %1").arg(arguments[0]));
+        }
+
+        auto body = QJsonDocument::fromJson(request.body()).object();
+        auto timeoutSeconds = body["timeoutSeconds"].toInt(DRAIN_TIMEOUT_SECONDS);
+
+        return healthModel_.StartDrain(timeoutSeconds);
+    }
+
+    QJsonObject Put(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // ADMINAPIVIEW_H
@@ -0,0 +1,43 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef ADMINSETTINGS_H
+#define ADMINSETTINGS_H
+
+#include <QProcessEnvironment>
+#include <QString>
+
+// No admin listener by default
+#define ADMIN_LISTEN_PORT 0
+
+namespace dePhonica::Core::Api {
+
+// Listener of the admin views. It binds the loopback interface only: the admin views describe every session
+// and client of the node and are never served on the public port.
+struct AdminSettings
+{
+    quint16 ListenPort = ADMIN_LISTEN_PORT;
+
+    bool IsEnabled() const { return ListenPort != 0; }
+
+    // Reads API_ADMIN_PORT
+    static AdminSettings FromEnvironment()
+    {
+        auto environment = QProcessEnvironment::systemEnvironment();
+
+        AdminSettings settings;
+        settings.ListenPort = static_cast<quint16>(environment.value("API_ADMIN_PORT", QString::number(ADMIN_LISTEN_PORT)).toUInt());
+
+        return settings;
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // ADMINSETTINGS_H
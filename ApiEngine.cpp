@@ -9,6 +9,16 @@
 
 #include "ApiEngine.h"
 
+#ifdef Q_OS_UNIX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <exception>
+#include <memory>
+
+#include <QDebug>
 #include <QJsonDocument>
 #include <QMetaEnum>
 
@@ -24,6 +34,8 @@ ApiEngine::ApiEngine(const QString& basePath, quint16 listenPort)
     {
         basePath_.append('/');
     }
+
+    deferredPool_.setMaxThreadCount(ROUTE_DEFERRED_THREADS);
 }
 
 ApiEngine::~ApiEngine()
@@ -32,10 +44,94 @@ ApiEngine::~ApiEngine()
 
 void ApiEngine::Listen()
 {
+    qintptr socketDescriptor = -1;
+
+    bool isInherited = false;
+    auto inheritedDescriptor = qEnvironmentVariableIntValue("API_LISTEN_FD", &isInherited);
+
+    if (isInherited)
+    {
+        socketDescriptor = inheritedDescriptor;
+    }
+    else
+    {
+        socketDescriptor = CreateReusePortSocket(listenPort_);
+    }
+
+    if (socketDescriptor >= 0)
+    {
+        tcpServer_ = new QTcpServer(&httpServer_);
+
+        if (tcpServer_->setSocketDescriptor(socketDescriptor))
+        {
+            httpServer_.bind(tcpServer_);
+            return;
+        }
+
+        qWarning() << "Unable to adopt the listening socket, falling back to a plain listener:" << tcpServer_->errorString();
+
+        delete tcpServer_;
+        tcpServer_ = nullptr;
+    }
+
     httpServer_.listen(QHostAddress::Any, listenPort_);
 }
 
-void ApiEngine::RouteHandler(const QStringList& pathArguments,
+void ApiEngine::ListenLocal()
+{
+    if (httpServer_.listen(QHostAddress::LocalHost, listenPort_) == 0)
+    {
+        qWarning() << "Unable to listen on the loopback port" << listenPort_;
+    }
+}
+
+void ApiEngine::StopListening()
+{
+    // Established connections stay open and keep being served, new ones go to the replacement process
+    for (auto server : httpServer_.servers())
+    {
+        server->close();
+    }
+}
+
+qintptr ApiEngine::ListeningSocketDescriptor() const
+{
+    return tcpServer_ != nullptr ? tcpServer_->socketDescriptor() : -1;
+}
+
+qintptr ApiEngine::CreateReusePortSocket(quint16 listenPort)
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    int socketDescriptor = ::socket(AF_INET6, SOCK_STREAM, 0);
+    if (socketDescriptor < 0)
+    {
+        return -1;
+    }
+
+    int enable = 1, disable = 0;
+    ::setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    ::setsockopt(socketDescriptor, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+    ::setsockopt(socketDescriptor, IPPROTO_IPV6, IPV6_V6ONLY, &disable, sizeof(disable));
+
+    sockaddr_in6 address {};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons(listenPort);
+
+    if (::bind(socketDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(socketDescriptor, SOMAXCONN) != 0)
+    {
+        ::close(socketDescriptor);
+        return -1;
+    }
+
+    return socketDescriptor;
+#else
+    Q_UNUSED(listenPort)
+    return -1;
+#endif
+}
+
+void ApiEngine::RouteHandler(const RouteArguments& pathArguments,
                              IBaseApiView& viewInstance,
                              const QHttpServerRequest& request,
                              QHttpServerResponder& responder)
@@ -53,36 +149,93 @@ void ApiEngine::RouteHandler(const QStringList& pathArguments,
     }
     else
     {
-        try
+        IBaseApiView::DeferredHandler deferredHandler;
+
+        if (request.method() == QHttpServerRequest::Method::Post)
+        {
+            resultJson = InvokeHandler([&]() {
+                deferredHandler = viewInstance.PostDeferred(request, pathArguments);
+                return QJsonObject();
+            });
+        }
+
+        if (deferredHandler)
         {
-            switch (request.method())
-            {
-            case QHttpServerRequest::Method::Get:
-                resultJson = viewInstance.Get(request, pathArguments);
-                break;
-
-            case QHttpServerRequest::Method::Post:
-                resultJson = viewInstance.Post(request, pathArguments);
-                break;
-
-            case QHttpServerRequest::Method::Put:
-                resultJson = viewInstance.Put(request, pathArguments);
-                break;
-
-            case QHttpServerRequest::Method::Delete:
-                resultJson = viewInstance.Delete(request, pathArguments);
-                break;
-
-            default:
-                break;
-            }
+            // The responder moves to the pool and back, the response is written on the event loop thread
+            auto deferredResponder = std::make_shared<QHttpServerResponder>(std::move(responder));
+
+            deferredPool_.start([this, deferredHandler, deferredResponder]() {
+                auto deferredResult = InvokeHandler(deferredHandler);
+
+                QMetaObject::invokeMethod(
+                    &httpServer_, [deferredResponder, deferredResult]() { Respond(*deferredResponder, deferredResult); }, Qt::QueuedConnection);
+            });
+
+            return;
         }
-        catch (CoreException& ex)
+
+        QByteArray serializedResult;
+
+        if (resultJson.isEmpty())
         {
-            resultJson = QJsonObject({ { "result", "error" }, { "message", ex.what() } });
+            resultJson = InvokeHandler([&]() {
+                serializedResult = viewInstance.Serialized(request, pathArguments);
+                return QJsonObject();
+            });
+        }
+
+        if (serializedResult.isEmpty() == false)
+        {
+            responder.write(serializedResult, "application/json", QHttpServerResponder::StatusCode::Ok);
+            return;
+        }
+
+        if (resultJson.isEmpty())
+        {
+            resultJson = InvokeHandler([&]() {
+                switch (request.method())
+                {
+                case QHttpServerRequest::Method::Get:
+                    return viewInstance.Get(request, pathArguments);
+
+                case QHttpServerRequest::Method::Post:
+                    return viewInstance.Post(request, pathArguments);
+
+                case QHttpServerRequest::Method::Put:
+                    return viewInstance.Put(request, pathArguments);
+
+                case QHttpServerRequest::Method::Delete:
+                    return viewInstance.Delete(request, pathArguments);
+
+                default:
+                    return QJsonObject();
+                }
+            });
         }
     }
 
+    Respond(responder, resultJson);
+}
+
+QJsonObject ApiEngine::InvokeHandler(const std::function<QJsonObject()>& handler)
+{
+    try
+    {
+        return handler();
+    }
+    catch (CoreException& ex)
+    {
+        return QJsonObject({ { "result", "error" }, { "message", ex.what() } });
+    }
+    catch (std::exception& ex)
+    {
+        // Allocation and container failures on bad input fail the request, not the process
+        return QJsonObject({ { "result", "error" }, { "message", QString("Internal error: %1").arg(ex.what()) } });
+    }
+}
+
+void ApiEngine::Respond(QHttpServerResponder& responder, const QJsonObject& resultJson)
+{
     auto statusCode = resultJson.contains("result") && resultJson["result"].toString() == "error"
                           ? QHttpServerResponder::StatusCode::BadRequest
                           : QHttpServerResponder::StatusCode::Ok;
@@ -105,84 +258,12 @@ void ApiEngine::AddEndpoint(IBaseApiView& viewInstance, const QString& overrideU
     {
         size_t argCount = path.count("<arg>");
 
-        if (argCount == 0)
-        {
-            httpServer_.route(basePath_ + path, [this, &viewInstance](const QHttpServerRequest& request, QHttpServerResponder&& responder) {
-                QStringList pathArguments;
-                RouteHandler(pathArguments, viewInstance, request, responder);
-            });
-        }
-        else if (argCount == 1)
-        {
-            httpServer_.route(basePath_ + path,
-                              [this, &viewInstance](QString arg1, const QHttpServerRequest& request, QHttpServerResponder&& responder) {
-                                  QStringList pathArguments;
-                                  pathArguments.append(arg1);
-                                  RouteHandler(pathArguments, viewInstance, request, responder);
-                              });
-        }
-        else if (argCount == 2)
-        {
-            httpServer_.route(
-                basePath_ + path,
-                [this, &viewInstance](QString arg1, QString arg2, const QHttpServerRequest& request, QHttpServerResponder&& responder) {
-                    QStringList pathArguments;
-                    pathArguments.append(arg1);
-                    pathArguments.append(arg2);
-                    RouteHandler(pathArguments, viewInstance, request, responder);
-                });
-        }
-        else if (argCount == 3)
+        if (argCount > ROUTE_MAX_ARGUMENTS)
         {
-            httpServer_.route(basePath_ + path,
-                              [this, &viewInstance](QString arg1,
-                                                    QString arg2,
-                                                    QString arg3,
-                                                    const QHttpServerRequest& request,
-                                                    QHttpServerResponder&& responder) {
-                                  QStringList pathArguments;
-                                  pathArguments.append(arg1);
-                                  pathArguments.append(arg2);
-                                  pathArguments.append(arg3);
-                                  RouteHandler(pathArguments, viewInstance, request, responder);
-                              });
-        }
-        else if (argCount == 4)
-        {
-            httpServer_.route(basePath_ + path,
-                              [this, &viewInstance](QString arg1,
-                                                    QString arg2,
-                                                    QString arg3,
-                                                    QString arg4,
-                                                    const QHttpServerRequest& request,
-                                                    QHttpServerResponder&& responder) {
-                                  QStringList pathArguments;
-                                  pathArguments.append(arg1);
-                                  pathArguments.append(arg2);
-                                  pathArguments.append(arg3);
-                                  pathArguments.append(arg4);
-                                  RouteHandler(pathArguments, viewInstance, request, responder);
-                              });
-        }
-        else if (argCount == 5)
-        {
-            httpServer_.route(basePath_ + path,
-                              [this, &viewInstance](QString arg1,
-                                                    QString arg2,
-                                                    QString arg3,
-                                                    QString arg4,
-                                                    QString arg5,
-                                                    const QHttpServerRequest& request,
-                                                    QHttpServerResponder&& responder) {
-                                  QStringList pathArguments;
-                                  pathArguments.append(arg1);
-                                  pathArguments.append(arg2);
-                                  pathArguments.append(arg3);
-                                  pathArguments.append(arg4);
-                                  pathArguments.append(arg5);
-                                  RouteHandler(pathArguments, viewInstance, request, responder);
-                              });
+            throw CoreException(QString("Unable to add endpoint %1 - more than %2 path arguments").arg(path).arg(ROUTE_MAX_ARGUMENTS));
         }
+
+        AddRouteWithCount(argCount, basePath_ + path, viewInstance, std::make_index_sequence<ROUTE_MAX_ARGUMENTS + 1>());
     }
 }
 
@@ -10,17 +10,27 @@
 #ifndef APIENGINE_H
 #define APIENGINE_H
 
+#include <array>
 #include <memory>
+#include <utility>
 #include <vector>
 
 #include <QHttpServer>
 #include <QJsonArray>
 #include <QObject>
 #include <QString>
+#include <QTcpServer>
+#include <QThreadPool>
 
 #include "IBaseApiView.h"
+#include "RouteArguments.h"
 #include "CoreException.h"
 
+// Most <arg> values any view registers in one endpoint
+#define ROUTE_MAX_ARGUMENTS 3
+// Threads running deferred handlers, see IBaseApiView::PostDeferred
+#define ROUTE_DEFERRED_THREADS 16
+
 namespace dePhonica::Core::Api {
 
 class ApiEngine
@@ -31,13 +41,26 @@ private:
 
     quint16 listenPort_;
 
+    // Listening socket created by the engine itself, see Listen
+    QTcpServer* tcpServer_ = nullptr;
+
+    // Declared after the server so it is destroyed first, waiting for the running handlers
+    QThreadPool deferredPool_;
+
 public:
     ApiEngine(const QString& basePath, quint16 listenPort);
     ~ApiEngine();
 
     void AddEndpoint(IBaseApiView& viewInstance, const QString& overrideUriPath = "");
 
+    // Listens on a socket inherited through API_LISTEN_FD, or on a new SO_REUSEPORT socket, so a replacement
+    // process can take over the port while this one drains
     void Listen();
+    // Listens on the loopback interface only, for views which must not be reachable from other hosts
+    void ListenLocal();
+    void StopListening();
+
+    qintptr ListeningSocketDescriptor() const;
 
     static QJsonObject ToError(QString message) { return { { "result", "error" }, { "message", message } }; }
 
@@ -88,7 +111,43 @@ public:
     }
 
 private:
-    void RouteHandler(const QStringList& pathArguments, IBaseApiView& viewInstance, const QHttpServerRequest& request, QHttpServerResponder& responder);
+    static qintptr CreateReusePortSocket(quint16 listenPort);
+
+    void RouteHandler(const RouteArguments& pathArguments,
+                      IBaseApiView& viewInstance,
+                      const QHttpServerRequest& request,
+                      QHttpServerResponder& responder);
+
+    // Calls the handler, turning its exceptions into an error result
+    static QJsonObject InvokeHandler(const std::function<QJsonObject()>& handler);
+
+    static void Respond(QHttpServerResponder& responder, const QJsonObject& resultJson);
+
+    template<size_t>
+    using RouteArgument = QString;
+
+    // Registers a handler taking exactly sizeof...(Indices) path arguments. QHttpServer's router captures every
+    // <arg> as a QString of its own; they are moved into an array on the stack and reach the view as a
+    // RouteArguments view, so the engine adds no copies or lists. Views keep the untyped Get/Post/Put/Delete
+    // interface and parse their arguments themselves.
+    template<size_t... Indices>
+    void AddRoute(const QString& path, IBaseApiView& viewInstance, std::index_sequence<Indices...>)
+    {
+        httpServer_.route(path,
+                          [this, &viewInstance](RouteArgument<Indices>... arguments,
+                                                const QHttpServerRequest& request,
+                                                QHttpServerResponder&& responder) {
+                              std::array<QString, sizeof...(Indices)> argumentsArray { std::move(arguments)... };
+                              RouteHandler(RouteArguments(argumentsArray.data(), argumentsArray.size()), viewInstance, request, responder);
+                          });
+    }
+
+    // Selects the AddRoute instance for a count of arguments known at run time only
+    template<size_t... Counts>
+    void AddRouteWithCount(size_t argumentsCount, const QString& path, IBaseApiView& viewInstance, std::index_sequence<Counts...>)
+    {
+        ((argumentsCount == Counts ? AddRoute(path, viewInstance, std::make_index_sequence<Counts>()) : void()), ...);
+    }
 };
 
 } // namespace dePhonica::Core::Api
@@ -9,12 +9,26 @@
 
 #include "ApiInstance.h"
 
+#include <csignal>
+
+#include "API/Dsp/Kernels.h"
+
 namespace dePhonica::Core::Api {
 
-ApiInstance::ApiInstance(QString baseUri, quint16 listenPort, ICoreInstance &coreInstance)
+ApiInstance::ApiInstance(QString baseUri, quint16 listenPort, ICoreInstance &coreInstance,
+                         const ShardSettings& shardSettings, const WarmUpSettings& warmUpSettings,
+                         const AdminSettings& adminSettings)
     : coreInstance_(coreInstance)
-    , sessionView_(coreInstance)
+    , sessionView_(coreInstance, shardSettings)
+    , sessionBatchView_(sessionView_.Model())
+    , shardView_(sessionView_.Model().Services())
+    // Distributed API nodes search on the shards, there is nothing local to warm
+    , warmUp_(coreInstance, sessionView_.Model().CatalogueSearches(), shardSettings.IsEnabled() ? WarmUpSettings { false } : warmUpSettings)
     , apiEngine_(baseUri, listenPort)
+    , healthView_(apiEngine_, sessionView_.Model(), warmUp_)
+    , adminSettings_(adminSettings)
+    , adminEngine_(baseUri, adminSettings.ListenPort)
+    , adminView_(sessionView_.Model(), healthView_.Model())
 {
 }
 
@@ -22,8 +36,32 @@ void ApiInstance::Start()
 {
     apiEngine_.AddEndpoint(versionView_);
     apiEngine_.AddEndpoint(sessionView_);
+    apiEngine_.AddEndpoint(sessionBatchView_);
+    apiEngine_.AddEndpoint(shardView_);
+    apiEngine_.AddEndpoint(healthView_);
+
+    // Selects and self-checks the DSP kernels before any request, so no search pays for it and
+    // version reports the variant in use from the first call
+    Kernels::Active();
 
+    sessionView_.Model().Prepare();
+
+    // health/ready stays false until the warm-up completes
     apiEngine_.Listen();
+    healthView_.Model().DrainOnSignal(SIGTERM);
+
+    if (adminSettings_.IsEnabled())
+    {
+        adminEngine_.AddEndpoint(adminView_);
+        adminEngine_.ListenLocal();
+    }
+
+    warmUp_.Start();
+}
+
+QJsonObject ApiInstance::Drain(int timeoutSeconds)
+{
+    return healthView_.Model().StartDrain(timeoutSeconds);
 }
 
 } // namespace dePhonica::Core::Api
@@ -14,7 +14,14 @@
 #include "CoreInstance.h"
 
 #include "API/Version/VersionApiView.h"
+#include "API/Admin/AdminApiView.h"
+#include "API/Admin/AdminSettings.h"
+#include "API/Health/HealthApiView.h"
+#include "API/Search/SearchWarmUp.h"
 #include "API/Session/SessionApiView.h"
+#include "API/Session/SessionBatchApiView.h"
+#include "API/Shards/ShardApiView.h"
+#include "API/Shards/ShardSettings.h"
 
 namespace dePhonica::Core::Api {
 
@@ -27,13 +34,31 @@ private:
 
     VersionApiView versionView_;
     SessionApiView sessionView_;
+    SessionBatchApiView sessionBatchView_;
+    ShardApiView shardView_;
 
+    SearchWarmUp warmUp_;
     ApiEngine apiEngine_;
+    HealthApiView healthView_;
+
+    // Serves the admin views on the loopback interface, see AdminSettings
+    const AdminSettings adminSettings_;
+    ApiEngine adminEngine_;
+    AdminApiView adminView_;
 
 public:
-    ApiInstance(QString baseUri, quint16 listenPort, ICoreInstance& coreInstance);
+    ApiInstance(QString baseUri,
+                quint16 listenPort,
+                ICoreInstance& coreInstance,
+                const ShardSettings& shardSettings = ShardSettings::FromEnvironment(),
+                const WarmUpSettings& warmUpSettings = WarmUpSettings::FromEnvironment(),
+                const AdminSettings& adminSettings = AdminSettings::FromEnvironment());
 
+    // Starts listening, then warms the search up in the background
     void Start();
+
+    // Closes the listening socket, stops accepting sessions and waits for running ones
+    QJsonObject Drain(int timeoutSeconds = DRAIN_TIMEOUT_SECONDS);
 };
 
 } // namespace dePhonica::Core::Api
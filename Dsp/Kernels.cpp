@@ -0,0 +1,490 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "Kernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// Builds with -mfma or -march=native and -ffp-contract=fast would fuse a * b + c in the portable loops
+// into FMA, which rounds differently from the variants and fails the self-check
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace dePhonica::Core::Api {
+
+namespace {
+
+// Variants must give bit-identical results: float loops keep the lane layout and the summation
+// order of the portable loops and are compiled without FMA, which would round differently
+
+float FinishDot(const float* lanes, const float* a, const float* b, size_t n, size_t count)
+{
+    float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; n < count; n++)
+    {
+        sum += a[n] * b[n];
+    }
+
+    return sum;
+}
+
+float DotGeneric(const float* a, const float* b, size_t count)
+{
+    // Independent lanes let the compiler vectorize the loop without reassociating a single sum
+    float lanes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        for (size_t lane = 0; lane < 8; lane++)
+        {
+            lanes[lane] += a[n + lane] * b[n + lane];
+        }
+    }
+
+    return FinishDot(lanes, a, b, n, count);
+}
+
+void DownmixGeneric(const float* interleaved, size_t framesCount, size_t channelsCount, float* mono)
+{
+    if (channelsCount == 2)
+    {
+        for (size_t n = 0; n < framesCount; n++)
+        {
+            mono[n] = (interleaved[n * 2] + interleaved[n * 2 + 1]) * 0.5f;
+        }
+
+        return;
+    }
+
+    float scale = 1.0f / channelsCount;
+
+    for (size_t n = 0; n < framesCount; n++)
+    {
+        float sum = 0;
+        for (size_t channel = 0; channel < channelsCount; channel++)
+        {
+            sum += interleaved[n * channelsCount + channel];
+        }
+
+        mono[n] = sum * scale;
+    }
+}
+
+size_t IndicesAboveTail(const uint8_t* values, size_t n, size_t count, uint8_t threshold, uint32_t* indices, size_t found)
+{
+    for (; n < count; n++)
+    {
+        if (values[n] > threshold)
+        {
+            indices[found++] = static_cast<uint32_t>(n);
+        }
+    }
+
+    return found;
+}
+
+size_t IndicesAboveGeneric(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices)
+{
+    return IndicesAboveTail(values, 0, count, threshold, indices, 0);
+}
+
+void ConvertS16Tail(const int16_t* samples, size_t n, size_t count, float* converted)
+{
+    for (; n < count; n++)
+    {
+        converted[n] = static_cast<float>(samples[n]) / 32768.0f;
+    }
+}
+
+void ConvertS16Generic(const int16_t* samples, size_t count, float* converted)
+{
+    ConvertS16Tail(samples, 0, count, converted);
+}
+
+#ifdef KERNELS_X86
+
+// Scaling by a power of two is exact, so multiplying gives the same result as the portable division
+#define KERNELS_S16_SCALE (1.0f / 32768.0f)
+
+__attribute__((target("sse2"))) float DotSse2(const float* a, const float* b, size_t count)
+{
+    __m128 low = _mm_setzero_ps();
+    __m128 high = _mm_setzero_ps();
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        low = _mm_add_ps(low, _mm_mul_ps(_mm_loadu_ps(a + n), _mm_loadu_ps(b + n)));
+        high = _mm_add_ps(high, _mm_mul_ps(_mm_loadu_ps(a + n + 4), _mm_loadu_ps(b + n + 4)));
+    }
+
+    float lanes[8];
+    _mm_storeu_ps(lanes, low);
+    _mm_storeu_ps(lanes + 4, high);
+
+    return FinishDot(lanes, a, b, n, count);
+}
+
+__attribute__((target("sse2"))) void DownmixSse2(const float* interleaved, size_t framesCount, size_t channelsCount, float* mono)
+{
+    if (channelsCount != 2)
+    {
+        DownmixGeneric(interleaved, framesCount, channelsCount, mono);
+        return;
+    }
+
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    size_t n = 0;
+    for (; n + 4 <= framesCount; n += 4)
+    {
+        __m128 first = _mm_loadu_ps(interleaved + n * 2);
+        __m128 second = _mm_loadu_ps(interleaved + n * 2 + 4);
+
+        __m128 left = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(mono + n, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+
+    DownmixGeneric(interleaved + n * 2, framesCount - n, 2, mono + n);
+}
+
+__attribute__((target("sse2"))) size_t IndicesAboveSse2(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices)
+{
+    size_t found = 0;
+    size_t n = 0;
+
+    // SSE2 has signed byte compares only, flipping the sign bit maps unsigned order onto signed order
+    const __m128i signBit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i thresholdBiased = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(threshold)), signBit);
+
+    for (; n + 16 <= count; n += 16)
+    {
+        __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + n)), signBit);
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(block, thresholdBiased)));
+
+        while (mask != 0)
+        {
+            indices[found++] = static_cast<uint32_t>(n + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return IndicesAboveTail(values, n, count, threshold, indices, found);
+}
+
+__attribute__((target("sse2"))) void ConvertS16Sse2(const int16_t* samples, size_t count, float* converted)
+{
+    const __m128 scale = _mm_set1_ps(KERNELS_S16_SCALE);
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + n));
+
+        // Unpacking a value with itself and shifting back sign-extends it to 32 bits
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(block, block), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(block, block), 16);
+
+        _mm_storeu_ps(converted + n, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(converted + n + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+
+    ConvertS16Tail(samples, n, count, converted);
+}
+
+__attribute__((target("avx2"))) float DotAvx2(const float* a, const float* b, size_t count)
+{
+    __m256 sum = _mm256_setzero_ps();
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + n), _mm256_loadu_ps(b + n)));
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, sum);
+
+    return FinishDot(lanes, a, b, n, count);
+}
+
+__attribute__((target("avx2"))) void DownmixAvx2(const float* interleaved, size_t framesCount, size_t channelsCount, float* mono)
+{
+    if (channelsCount != 2)
+    {
+        DownmixGeneric(interleaved, framesCount, channelsCount, mono);
+        return;
+    }
+
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    size_t n = 0;
+    for (; n + 8 <= framesCount; n += 8)
+    {
+        // Pairwise sums come out as frames 0 1 4 5 2 3 6 7, the 64-bit permute restores the order
+        __m256 sums = _mm256_hadd_ps(_mm256_loadu_ps(interleaved + n * 2), _mm256_loadu_ps(interleaved + n * 2 + 8));
+        sums = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sums), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(mono + n, _mm256_mul_ps(sums, half));
+    }
+
+    DownmixGeneric(interleaved + n * 2, framesCount - n, 2, mono + n);
+}
+
+__attribute__((target("avx2"))) size_t IndicesAboveAvx2(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices)
+{
+    size_t found = 0;
+    size_t n = 0;
+
+    const __m256i signBit = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i thresholdBiased = _mm256_xor_si256(_mm256_set1_epi8(static_cast<char>(threshold)), signBit);
+
+    for (; n + 32 <= count; n += 32)
+    {
+        __m256i block = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + n)), signBit);
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(block, thresholdBiased)));
+
+        while (mask != 0)
+        {
+            indices[found++] = static_cast<uint32_t>(n + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return IndicesAboveTail(values, n, count, threshold, indices, found);
+}
+
+__attribute__((target("avx2"))) void ConvertS16Avx2(const int16_t* samples, size_t count, float* converted)
+{
+    const __m256 scale = _mm256_set1_ps(KERNELS_S16_SCALE);
+
+    size_t n = 0;
+    for (; n + 8 <= count; n += 8)
+    {
+        __m256i block = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + n)));
+        _mm256_storeu_ps(converted + n, _mm256_mul_ps(_mm256_cvtepi32_ps(block), scale));
+    }
+
+    ConvertS16Tail(samples, n, count, converted);
+}
+
+// Float loops stay on AVX2 - AVX-512 implies FMA, and a 16-lane sum would change the summation order
+__attribute__((target("avx512f,avx512bw"))) size_t IndicesAboveAvx512(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices)
+{
+    size_t found = 0;
+    size_t n = 0;
+
+    const __m512i thresholds = _mm512_set1_epi8(static_cast<char>(threshold));
+
+    for (; n + 64 <= count; n += 64)
+    {
+        auto mask = static_cast<uint64_t>(_mm512_cmpgt_epu8_mask(_mm512_loadu_si512(values + n), thresholds));
+
+        while (mask != 0)
+        {
+            indices[found++] = static_cast<uint32_t>(n + __builtin_ctzll(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    return IndicesAboveTail(values, n, count, threshold, indices, found);
+}
+
+__attribute__((target("avx512f,avx512bw"))) void ConvertS16Avx512(const int16_t* samples, size_t count, float* converted)
+{
+    const __m512 scale = _mm512_set1_ps(KERNELS_S16_SCALE);
+
+    size_t n = 0;
+    for (; n + 16 <= count; n += 16)
+    {
+        __m512i block = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + n)));
+        _mm512_storeu_ps(converted + n, _mm512_mul_ps(_mm512_cvtepi32_ps(block), scale));
+    }
+
+    ConvertS16Tail(samples, n, count, converted);
+}
+
+#endif
+
+struct CompiledVariant
+{
+    Kernels::Variant Functions;
+    bool (*IsSupported)();
+};
+
+const CompiledVariant compiledVariants[] = {
+#ifdef KERNELS_X86
+    { { "avx512", DotAvx2, DownmixAvx2, IndicesAboveAvx512, ConvertS16Avx512 },
+      []() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx2"); } },
+    { { "avx2", DotAvx2, DownmixAvx2, IndicesAboveAvx2, ConvertS16Avx2 }, []() { return __builtin_cpu_supports("avx2") != 0; } },
+    { { "sse2", DotSse2, DownmixSse2, IndicesAboveSse2, ConvertS16Sse2 }, []() { return __builtin_cpu_supports("sse2") != 0; } },
+#endif
+    { { "generic", DotGeneric, DownmixGeneric, IndicesAboveGeneric, ConvertS16Generic }, []() { return true; } },
+};
+
+const size_t compiledVariantsCount = sizeof(compiledVariants) / sizeof(compiledVariants[0]);
+
+} // namespace
+
+bool Kernels::SelfCheck(const Variant& variant)
+{
+    const auto& reference = compiledVariants[compiledVariantsCount - 1].Functions;
+
+    // Counts around every vector width, so both the vector loops and their tails are covered
+    const size_t counts[] = { 0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 1000, 4099 };
+    const size_t maxCount = 4099;
+    const size_t maxChannels = 6;
+
+    uint32_t state = 12345;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    };
+
+    std::vector<float> a(maxCount * maxChannels), b(maxCount);
+    std::vector<uint8_t> bytes(maxCount);
+    std::vector<int16_t> shorts(maxCount);
+
+    for (auto& value : a)
+    {
+        value = static_cast<float>(next()) / (1 << 23) - 1.0f;
+    }
+
+    for (auto& value : b)
+    {
+        value = static_cast<float>(next()) / (1 << 23) - 1.0f;
+    }
+
+    for (auto& value : bytes)
+    {
+        value = static_cast<uint8_t>(next());
+    }
+
+    for (auto& value : shorts)
+    {
+        value = static_cast<int16_t>(next());
+    }
+
+    std::vector<float> expected(maxCount), actual(maxCount);
+    std::vector<uint32_t> expectedIndices(maxCount), actualIndices(maxCount);
+
+    for (auto count : counts)
+    {
+        float expectedDot = reference.Dot(a.data(), b.data(), count);
+        float actualDot = variant.Dot(a.data(), b.data(), count);
+
+        if (std::memcmp(&expectedDot, &actualDot, sizeof(float)) != 0)
+        {
+            return false;
+        }
+
+        for (size_t channels : { 1, 2, 3, 6 })
+        {
+            reference.Downmix(a.data(), count, channels, expected.data());
+            variant.Downmix(a.data(), count, channels, actual.data());
+
+            if (std::memcmp(expected.data(), actual.data(), count * sizeof(float)) != 0)
+            {
+                return false;
+            }
+        }
+
+        for (uint8_t threshold : { 0, 127, 128, 200, 255 })
+        {
+            auto expectedFound = reference.IndicesAbove(bytes.data(), count, threshold, expectedIndices.data());
+            auto actualFound = variant.IndicesAbove(bytes.data(), count, threshold, actualIndices.data());
+
+            if (expectedFound != actualFound
+                || std::memcmp(expectedIndices.data(), actualIndices.data(), expectedFound * sizeof(uint32_t)) != 0)
+            {
+                return false;
+            }
+        }
+
+        reference.ConvertS16(shorts.data(), count, expected.data());
+        variant.ConvertS16(shorts.data(), count, actual.data());
+
+        if (std::memcmp(expected.data(), actual.data(), count * sizeof(float)) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const std::vector<Kernels::VariantStatus>& Kernels::Statuses()
+{
+    static const auto statuses = []() {
+#ifdef KERNELS_X86
+        __builtin_cpu_init();
+#endif
+
+        std::vector<VariantStatus> statuses;
+
+        for (const auto& compiled : compiledVariants)
+        {
+            bool isSupported = compiled.IsSupported();
+            statuses.push_back({ compiled.Functions.Name, isSupported, isSupported && SelfCheck(compiled.Functions) });
+        }
+
+        return statuses;
+    }();
+
+    return statuses;
+}
+
+const Kernels::Variant& Kernels::Active()
+{
+    static const Variant& active = []() -> const Variant& {
+        const auto& statuses = Statuses();
+        auto forcedName = std::getenv(KERNELS_VARIANT_VARIABLE);
+
+        if (forcedName != nullptr)
+        {
+            for (size_t n = 0; n < compiledVariantsCount; n++)
+            {
+                if (statuses[n].IsVerified && std::strcmp(statuses[n].Name, forcedName) == 0)
+                {
+                    return compiledVariants[n].Functions;
+                }
+            }
+        }
+
+        // The portable variant is its own reference, so the loop always ends on a verified one
+        size_t n = 0;
+        while (n + 1 < compiledVariantsCount && statuses[n].IsVerified == false)
+        {
+            n++;
+        }
+
+        return compiledVariants[n].Functions;
+    }();
+
+    return active;
+}
+
+std::vector<Kernels::VariantStatus> Kernels::Variants()
+{
+    return Statuses();
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,77 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Forces a kernel variant by name, unless the CPU lacks it or it fails the self-check
+#define KERNELS_VARIANT_VARIABLE "DSP_KERNELS"
+
+namespace dePhonica::Core::Api {
+
+// Inner loops shared by the ingest DSP and fingerprint stages. Every loop has a portable variant and
+// variants for wider x86 instruction sets, compiled side by side in one binary. The best variant the
+// CPU supports is chosen after a self-check that it gives bit-identical results. The choice is made on
+// first use, which ApiInstance::Start forces before the node serves requests.
+class Kernels
+{
+public:
+    struct Variant
+    {
+        const char* Name;
+
+        float (*Dot)(const float* a, const float* b, size_t count);
+        void (*Downmix)(const float* interleaved, size_t framesCount, size_t channelsCount, float* mono);
+        size_t (*IndicesAbove)(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices);
+        void (*ConvertS16)(const int16_t* samples, size_t count, float* converted);
+    };
+
+    struct VariantStatus
+    {
+        const char* Name;
+        bool IsSupported;
+        bool IsVerified;
+    };
+
+    static float Dot(const float* a, const float* b, size_t count) { return Active().Dot(a, b, count); }
+
+    // Averages interleaved frames into a mono stream
+    static void Downmix(const float* interleaved, size_t framesCount, size_t channelsCount, float* mono)
+    {
+        Active().Downmix(interleaved, framesCount, channelsCount, mono);
+    }
+
+    // Writes the ascending indices of values greater than threshold, returns how many were written
+    static size_t IndicesAbove(const uint8_t* values, size_t count, uint8_t threshold, uint32_t* indices)
+    {
+        return Active().IndicesAbove(values, count, threshold, indices);
+    }
+
+    // Scales signed 16-bit samples to [-1, 1)
+    static void ConvertS16(const int16_t* samples, size_t count, float* converted) { Active().ConvertS16(samples, count, converted); }
+
+    static const Variant& Active();
+
+    // Every variant compiled in, best first, with its CPU support and self-check result
+    static std::vector<VariantStatus> Variants();
+
+private:
+    static const std::vector<VariantStatus>& Statuses();
+
+    // Compares a variant with the portable one on pseudo-random input
+    static bool SelfCheck(const Variant& variant);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // KERNELS_H
@@ -0,0 +1,184 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SignalGate.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "API/Dsp/Kernels.h"
+
+namespace dePhonica::Core::Api {
+
+SignalGate::SignalGate(float silenceThresholdDb, float flatnessThreshold)
+    : silenceThresholdDb_(silenceThresholdDb)
+    , flatnessThreshold_(flatnessThreshold)
+{
+    pendingSamples_.reserve(SIGNAL_GATE_BLOCK_SAMPLES);
+}
+
+void SignalGate::Configure(float silenceThresholdDb, float flatnessThreshold)
+{
+    silenceThresholdDb_ = silenceThresholdDb;
+    flatnessThreshold_ = flatnessThreshold;
+}
+
+void SignalGate::Reset()
+{
+    isBlockSilent_.clear();
+    pendingSamples_.clear();
+    silentBlocksCount_ = 0;
+    isPendingSilent_ = false;
+}
+
+void SignalGate::Push(const float* samples, size_t samplesCount)
+{
+    while (samplesCount > 0)
+    {
+        if (pendingSamples_.empty() && samplesCount >= SIGNAL_GATE_BLOCK_SAMPLES)
+        {
+            bool isSilent = IsBlockSilent(samples, SIGNAL_GATE_BLOCK_SAMPLES);
+            isBlockSilent_.push_back(isSilent ? 1 : 0);
+            silentBlocksCount_ += isSilent ? 1 : 0;
+
+            samples += SIGNAL_GATE_BLOCK_SAMPLES;
+            samplesCount -= SIGNAL_GATE_BLOCK_SAMPLES;
+            continue;
+        }
+
+        size_t copyCount = std::min(samplesCount, SIGNAL_GATE_BLOCK_SAMPLES - pendingSamples_.size());
+        pendingSamples_.insert(pendingSamples_.end(), samples, samples + copyCount);
+
+        samples += copyCount;
+        samplesCount -= copyCount;
+
+        if (pendingSamples_.size() == SIGNAL_GATE_BLOCK_SAMPLES)
+        {
+            bool isSilent = IsBlockSilent(pendingSamples_.data(), SIGNAL_GATE_BLOCK_SAMPLES);
+            isBlockSilent_.push_back(isSilent ? 1 : 0);
+            silentBlocksCount_ += isSilent ? 1 : 0;
+
+            pendingSamples_.clear();
+        }
+    }
+
+    isPendingSilent_ = pendingSamples_.size() >= SIGNAL_GATE_MIN_PARTIAL_SAMPLES && IsBlockSilent(pendingSamples_.data(), pendingSamples_.size());
+}
+
+bool SignalGate::IsSilent(size_t sampleFrom, size_t sampleTo) const
+{
+    if (sampleTo <= sampleFrom || sampleTo > PushedSamples())
+    {
+        return false;
+    }
+
+    if (sampleTo > MeasuredSamples() && isPendingSilent_ == false)
+    {
+        return false;
+    }
+
+    size_t blockTo = std::min(isBlockSilent_.size(), (sampleTo + SIGNAL_GATE_BLOCK_SAMPLES - 1) / SIGNAL_GATE_BLOCK_SAMPLES);
+
+    for (size_t block = sampleFrom / SIGNAL_GATE_BLOCK_SAMPLES; block < blockTo; block++)
+    {
+        if (isBlockSilent_[block] == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SignalGate::HasSignal(size_t sampleFrom, size_t sampleTo) const
+{
+    if (sampleTo > MeasuredSamples() && pendingSamples_.empty() == false && isPendingSilent_ == false)
+    {
+        return true;
+    }
+
+    size_t blockTo = std::min(isBlockSilent_.size(), (sampleTo + SIGNAL_GATE_BLOCK_SAMPLES - 1) / SIGNAL_GATE_BLOCK_SAMPLES);
+
+    for (size_t block = sampleFrom / SIGNAL_GATE_BLOCK_SAMPLES; block < blockTo; block++)
+    {
+        if (isBlockSilent_[block] == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+float SignalGate::SpectralFlatness(const float* samples, size_t count, float energy)
+{
+    if (energy <= 0 || count <= SIGNAL_GATE_LPC_ORDER)
+    {
+        return 1.0f;
+    }
+
+    double autocorrelation[SIGNAL_GATE_LPC_ORDER + 1];
+    autocorrelation[0] = energy;
+
+    for (size_t lag = 1; lag <= SIGNAL_GATE_LPC_ORDER; lag++)
+    {
+        autocorrelation[lag] = Kernels::Dot(samples, samples + lag, count - lag);
+    }
+
+    // Levinson-Durbin recursion, only the prediction error is needed
+    double coefficients[SIGNAL_GATE_LPC_ORDER + 1] = { 1.0 };
+    double error = autocorrelation[0];
+
+    for (size_t order = 1; order <= SIGNAL_GATE_LPC_ORDER; order++)
+    {
+        double accumulator = autocorrelation[order];
+        for (size_t n = 1; n < order; n++)
+        {
+            accumulator += coefficients[n] * autocorrelation[order - n];
+        }
+
+        double reflection = -accumulator / error;
+
+        double updated[SIGNAL_GATE_LPC_ORDER + 1];
+        for (size_t n = 1; n < order; n++)
+        {
+            updated[n] = coefficients[n] + reflection * coefficients[order - n];
+        }
+
+        for (size_t n = 1; n < order; n++)
+        {
+            coefficients[n] = updated[n];
+        }
+
+        coefficients[order] = reflection;
+        error *= 1.0 - reflection * reflection;
+
+        if (error <= 0)
+        {
+            return 0.0f;
+        }
+    }
+
+    return static_cast<float>(error / autocorrelation[0]);
+}
+
+bool SignalGate::IsBlockSilent(const float* samples, size_t count) const
+{
+    float energy = Kernels::Dot(samples, samples, count);
+    float meanSquare = energy / count;
+
+    if (meanSquare <= 0 || 10.0f * std::log10(meanSquare) < silenceThresholdDb_)
+    {
+        return true;
+    }
+
+    return SpectralFlatness(samples, count, energy) > flatnessThreshold_;
+}
+
+} // namespace dePhonica::Core::Api
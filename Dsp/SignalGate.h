@@ -0,0 +1,73 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SIGNALGATE_H
+#define SIGNALGATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define SIGNAL_GATE_BLOCK_SAMPLES 1024
+#define SIGNAL_GATE_LPC_ORDER 8
+#define SIGNAL_GATE_SILENCE_DB -55.0f
+#define SIGNAL_GATE_FLATNESS 0.85f
+// Shortest trailing partial block which is measured, shorter tails count as signal
+#define SIGNAL_GATE_MIN_PARTIAL_SAMPLES 256
+
+namespace dePhonica::Core::Api {
+
+// Marks blocks of the collected stream which carry no usable signal - either their RMS level is
+// below the silence threshold or their spectrum is noise-flat. Spectral flatness is estimated as the
+// normalized prediction error of a short LPC model, which needs only a few autocorrelation lags per block.
+// Samples which do not complete a block are carried into the next push; until then the partial block is
+// measured on its own, so the newest audio of the stream is never ignored.
+class SignalGate
+{
+private:
+    float silenceThresholdDb_;
+    float flatnessThreshold_;
+
+    std::vector<uint8_t> isBlockSilent_;
+    std::vector<float> pendingSamples_;
+
+    size_t silentBlocksCount_ = 0;
+    bool isPendingSilent_ = false;
+
+public:
+    SignalGate(float silenceThresholdDb = SIGNAL_GATE_SILENCE_DB, float flatnessThreshold = SIGNAL_GATE_FLATNESS);
+
+    void Configure(float silenceThresholdDb, float flatnessThreshold);
+    void Reset();
+
+    // Feeds samples appended to the collected stream, measures every block they complete and the partial block left
+    void Push(const float* samples, size_t samplesCount);
+
+    // True when [sampleFrom, sampleTo) is measured completely and every block overlapping it, including the
+    // partial one, is silent
+    bool IsSilent(size_t sampleFrom, size_t sampleTo) const;
+
+    // True when any measured block overlapping [sampleFrom, sampleTo), including the partial one, carries signal
+    bool HasSignal(size_t sampleFrom, size_t sampleTo) const;
+
+    // Samples in complete blocks
+    size_t MeasuredSamples() const { return isBlockSilent_.size() * SIGNAL_GATE_BLOCK_SAMPLES; }
+    // Samples pushed so far, the complete blocks and the partial one
+    size_t PushedSamples() const { return MeasuredSamples() + pendingSamples_.size(); }
+    size_t SilentSamples() const { return silentBlocksCount_ * SIGNAL_GATE_BLOCK_SAMPLES; }
+
+    static float SpectralFlatness(const float* samples, size_t count, float energy);
+
+private:
+    bool IsBlockSilent(const float* samples, size_t count) const;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SIGNALGATE_H
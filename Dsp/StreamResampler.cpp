@@ -0,0 +1,214 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "StreamResampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <utility>
+
+#include "API/Dsp/Kernels.h"
+
+namespace dePhonica::Core::Api {
+
+namespace {
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+double BesselI0(double x)
+{
+    double sum = 1, term = 1;
+
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+} // namespace
+
+std::shared_ptr<const ResamplerFilter> ResamplerFilter::Design(size_t upFactor, size_t downFactor)
+{
+    // Frequencies in cycles per sample at the upsampled rate, the lower Nyquist frequency bounds the stopband
+    const double stopbandEdge = 0.5 / std::max(upFactor, downFactor);
+    const double transitionWidth = RESAMPLER_TRANSITION_WIDTH * stopbandEdge;
+    const double cutoff = stopbandEdge - transitionWidth / 2;
+
+    // Kaiser's estimates of the length and shape for the stopband attenuation and transition width
+    const double attenuation = RESAMPLER_STOPBAND_DB;
+    const double beta = attenuation > 50 ? 0.1102 * (attenuation - 8.7) : 0.5842 * std::pow(attenuation - 21, 0.4) + 0.07886 * (attenuation - 21);
+    const double length = (attenuation - 7.95) / (2.285 * 2 * M_PI * transitionWidth) + 1;
+
+    // Every phase gets the same whole number of taps, rounded up to a multiple of 8 for the vector kernels
+    size_t tapsPerPhase = static_cast<size_t>(std::ceil(length / upFactor));
+    tapsPerPhase = std::min<size_t>(RESAMPLER_MAX_TAPS_PER_PHASE, (tapsPerPhase + 7) / 8 * 8);
+
+    const size_t tapsCount = upFactor * tapsPerPhase;
+    const double stopbandDb = 2.285 * 2 * M_PI * transitionWidth * (tapsCount - 1) + 7.95;
+    const double center = (tapsCount - 1) / 2.0;
+    const double windowNorm = BesselI0(beta);
+
+    std::vector<double> prototype(tapsCount);
+    double prototypeSum = 0;
+
+    for (size_t n = 0; n < tapsCount; n++)
+    {
+        double x = 2.0 * cutoff * (n - center);
+        double sinc = x == 0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double ratio = tapsCount > 1 ? (n - center) / center : 0;
+        double window = BesselI0(beta * std::sqrt(std::max(0.0, 1 - ratio * ratio))) / windowNorm;
+
+        prototype[n] = sinc * window;
+        prototypeSum += prototype[n];
+    }
+
+    // Zero stuffing divides the signal energy by upFactor, restore unity gain per phase
+    double gain = upFactor / prototypeSum;
+
+    auto filter = std::make_shared<ResamplerFilter>();
+    filter->TapsPerPhase = tapsPerPhase;
+    filter->PhaseTaps.resize(tapsCount);
+    filter->StopbandDb = std::min(stopbandDb, attenuation);
+
+    for (size_t phase = 0; phase < upFactor; phase++)
+    {
+        for (size_t tap = 0; tap < tapsPerPhase; tap++)
+        {
+            filter->PhaseTaps[phase * tapsPerPhase + tap] = static_cast<float>(prototype[phase + (tapsPerPhase - 1 - tap) * upFactor] * gain);
+        }
+    }
+
+    return filter;
+}
+
+std::shared_ptr<const ResamplerFilter> ResamplerFilter::ForRatio(size_t upFactor, size_t downFactor)
+{
+    static std::mutex lock;
+    static std::map<std::pair<size_t, size_t>, std::shared_ptr<const ResamplerFilter>> filters;
+
+    {
+        std::lock_guard<std::mutex> locker(lock);
+
+        auto filterIterator = filters.find({ upFactor, downFactor });
+        if (filterIterator != filters.end())
+        {
+            return filterIterator->second;
+        }
+    }
+
+    auto filter = Design(upFactor, downFactor);
+
+    std::lock_guard<std::mutex> locker(lock);
+
+    // Sessions configuring the same ratio at once may design it twice, the first one stored is kept
+    auto filterIterator = filters.find({ upFactor, downFactor });
+    if (filterIterator != filters.end())
+    {
+        return filterIterator->second;
+    }
+
+    // The supported rates fit the cache, it only overflows with target rates it was not sized for
+    if (filters.size() < RESAMPLER_FILTERS_CACHED)
+    {
+        filters.emplace(std::make_pair(upFactor, downFactor), filter);
+    }
+
+    return filter;
+}
+
+bool StreamResampler::IsSupportedRate(size_t rate)
+{
+    static const size_t supportedRates[] = RESAMPLER_SUPPORTED_RATES;
+
+    return std::find(std::begin(supportedRates), std::end(supportedRates), rate) != std::end(supportedRates);
+}
+
+void StreamResampler::Configure(size_t inputRate, size_t outputRate, size_t channelsCount)
+{
+    inputRate_ = inputRate;
+    outputRate_ = outputRate;
+    channelsCount_ = channelsCount;
+
+    auto divisor = std::gcd(inputRate, outputRate);
+    upFactor_ = outputRate / divisor;
+    downFactor_ = inputRate / divisor;
+
+    filter_.reset();
+
+    if (upFactor_ != 1 || downFactor_ != 1)
+    {
+        filter_ = ResamplerFilter::ForRatio(upFactor_, downFactor_);
+    }
+
+    Reset();
+}
+
+void StreamResampler::Reset()
+{
+    history_.assign(filter_ == nullptr ? 0 : filter_->TapsPerPhase - 1, 0.0f);
+    phase_ = 0;
+}
+
+size_t StreamResampler::MaxOutputSamples(size_t framesCount) const
+{
+    if (filter_ == nullptr)
+    {
+        return framesCount;
+    }
+
+    return (history_.size() + framesCount) * upFactor_ / downFactor_ + 1;
+}
+
+size_t StreamResampler::Process(const float* interleaved, size_t framesCount, float* output)
+{
+    const float* mono = interleaved;
+
+    if (channelsCount_ > 1)
+    {
+        mono_.resize(framesCount);
+        Kernels::Downmix(interleaved, framesCount, channelsCount_, mono_.data());
+        mono = mono_.data();
+    }
+
+    if (filter_ == nullptr)
+    {
+        std::copy(mono, mono + framesCount, output);
+        return framesCount;
+    }
+
+    history_.insert(history_.end(), mono, mono + framesCount);
+
+    // Output sample k is taken at upsampled position k * downFactor_, its newest input sample is
+    // history_[position + tapsPerPhase - 1] and phase_ is the remainder modulo upFactor_
+    const size_t tapsPerPhase = filter_->TapsPerPhase;
+    const float* phaseTaps = filter_->PhaseTaps.data();
+
+    size_t position = 0;
+    size_t samplesWritten = 0;
+
+    while (position + tapsPerPhase <= history_.size())
+    {
+        output[samplesWritten++] = Kernels::Dot(phaseTaps + phase_ * tapsPerPhase, &history_[position], tapsPerPhase);
+
+        phase_ += downFactor_;
+        position += phase_ / upFactor_;
+        phase_ %= upFactor_;
+    }
+
+    history_.erase(history_.begin(), history_.begin() + std::min(position, history_.size()));
+
+    return samplesWritten;
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,87 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef STREAMRESAMPLER_H
+#define STREAMRESAMPLER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#define RESAMPLER_MAX_CHANNELS 8
+// Attenuation of the anti-aliasing filter above the lower of both Nyquist frequencies
+#define RESAMPLER_STOPBAND_DB 70.0
+// Transition band as a share of the lower Nyquist frequency, the passband ends where it starts
+#define RESAMPLER_TRANSITION_WIDTH 0.15
+// Enough for every supported rate to reach RESAMPLER_STOPBAND_DB, 192 kHz to 16 kHz needs the most
+#define RESAMPLER_MAX_TAPS_PER_PHASE 1024
+// Filters kept for reuse by all sessions, one per rate ratio - further ratios get a filter of their own
+#define RESAMPLER_FILTERS_CACHED 16
+// Input rates accepted by sessions. Their ratios to common target rates reduce to small factors, so every
+// filter stays small and all of them fit the filter cache.
+#define RESAMPLER_SUPPORTED_RATES { 8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000, 88200, 96000, 176400, 192000 }
+
+namespace dePhonica::Core::Api {
+
+// Polyphase form of a Kaiser-windowed sinc low-pass designed for one rate ratio. Its length follows from
+// the ratio, RESAMPLER_STOPBAND_DB and RESAMPLER_TRANSITION_WIDTH. Immutable, shared between resamplers.
+struct ResamplerFilter
+{
+    size_t TapsPerPhase;
+    // upFactor phases of TapsPerPhase taps each, stored reversed to match the history order
+    std::vector<float> PhaseTaps;
+    // Kaiser's estimate of the attenuation reached, below RESAMPLER_STOPBAND_DB only if the length was capped
+    // at RESAMPLER_MAX_TAPS_PER_PHASE
+    double StopbandDb;
+
+    bool MeetsStopband() const { return StopbandDb >= RESAMPLER_STOPBAND_DB; }
+
+    static std::shared_ptr<const ResamplerFilter> Design(size_t upFactor, size_t downFactor);
+    // Returns the cached filter of the ratio, designing it on first use. The design runs outside the cache
+    // lock, so sessions configuring other ratios do not wait for it.
+    static std::shared_ptr<const ResamplerFilter> ForRatio(size_t upFactor, size_t downFactor);
+};
+
+// Streaming downmix and rational polyphase resampling of interleaved input into a mono stream.
+// Filter history and phase are kept between Process calls, so the input may be split into chunks
+// at any frame boundary.
+class StreamResampler
+{
+private:
+    size_t inputRate_ = 0, outputRate_ = 0, channelsCount_ = 1;
+    size_t upFactor_ = 1, downFactor_ = 1;
+
+    // Null when the rates match
+    std::shared_ptr<const ResamplerFilter> filter_;
+    std::vector<float> history_;
+    std::vector<float> mono_;
+
+    size_t phase_ = 0;
+
+public:
+    static bool IsSupportedRate(size_t rate);
+
+    void Configure(size_t inputRate, size_t outputRate, size_t channelsCount);
+    void Reset();
+
+    // Null when the rates match
+    const ResamplerFilter* Filter() const { return filter_.get(); }
+
+    bool IsPassThrough() const { return upFactor_ == 1 && downFactor_ == 1 && channelsCount_ == 1; }
+    size_t ChannelsCount() const { return channelsCount_; }
+
+    size_t MaxOutputSamples(size_t framesCount) const;
+
+    // Consumes framesCount interleaved frames, returns the number of mono samples written to output
+    size_t Process(const float* interleaved, size_t framesCount, float* output);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // STREAMRESAMPLER_H
@@ -0,0 +1,174 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "AllocationCounter.h"
+
+#ifdef DEPHONICA_COUNT_ALLOCATIONS
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// Every replaceable form of operator new and delete is defined here, so no allocation reaches the
+// library's own operator new uncounted and no block is released by a mismatching delete
+
+namespace {
+
+thread_local uint64_t threadAllocations = 0;
+
+void* Allocate(std::size_t size) noexcept
+{
+    threadAllocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* AllocateAligned(std::size_t size, std::align_val_t alignment) noexcept
+{
+    threadAllocations++;
+
+    void* pointer = nullptr;
+    auto alignmentBytes = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+
+    return posix_memalign(&pointer, alignmentBytes, size == 0 ? 1 : size) == 0 ? pointer : nullptr;
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    if (auto pointer = Allocate(size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return Allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (auto pointer = AllocateAligned(size, alignment))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return ::operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return AllocateAligned(size, alignment);
+}
+
+// Blocks of malloc and posix_memalign are both released with free
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace dePhonica::Core::Api {
+
+bool AllocationCounter::IsEnabled()
+{
+#ifdef DEPHONICA_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t AllocationCounter::ThreadAllocations()
+{
+#ifdef DEPHONICA_COUNT_ALLOCATIONS
+    return threadAllocations;
+#else
+    return 0;
+#endif
+}
+
+} // namespace dePhonica::Core::Api
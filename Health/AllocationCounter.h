@@ -0,0 +1,29 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstdint>
+
+namespace dePhonica::Core::Api {
+
+// Counts operator new calls per thread. Counting replaces every global operator new and delete form,
+// plain, array, nothrow, aligned and sized, and is compiled in only with DEPHONICA_COUNT_ALLOCATIONS
+// defined, otherwise the counter stays at zero. Direct malloc calls, as in Qt containers, are not counted.
+class AllocationCounter
+{
+public:
+    static bool IsEnabled();
+    static uint64_t ThreadAllocations();
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,45 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "HealthApiModel.h"
+
+#include <csignal>
+
+namespace dePhonica::Core::Api {
+
+namespace {
+
+volatile std::sig_atomic_t isDrainSignaled = 0;
+
+void OnDrainSignal(int)
+{
+    isDrainSignaled = 1;
+}
+
+} // namespace
+
+void HealthApiModel::DrainOnSignal(int signalNumber)
+{
+    std::signal(signalNumber, OnDrainSignal);
+    signalTimer_.start();
+}
+
+void HealthApiModel::CheckSignal()
+{
+    if (isDrainSignaled == 0)
+    {
+        return;
+    }
+
+    // Further signals are ignored while draining, the drain timeout bounds the wait
+    signalTimer_.stop();
+    StartDrain();
+}
+
+} // namespace dePhonica::Core::Api
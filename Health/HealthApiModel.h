@@ -0,0 +1,149 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef HEALTHAPIMODEL_H
+#define HEALTHAPIMODEL_H
+
+#include <functional>
+
+#include <QCoreApplication>
+#include <QDeadlineTimer>
+#include <QJsonObject>
+#include <QTimer>
+
+#include "API/ApiEngine.h"
+#include "API/Search/SearchWarmUp.h"
+#include "API/Session/SessionApiModel.h"
+
+#define DRAIN_TIMEOUT_SECONDS 120
+#define DRAIN_POLL_MILLISECONDS 500
+
+namespace dePhonica::Core::Api {
+
+// Liveness, readiness and the drain state machine of the node. A drain stops new sessions and closes the
+// listening socket at once, then waits until the running sessions finish or the timeout passes and quits.
+// A drain is started by a signal, see DrainOnSignal, or through the loopback admin listener, never from
+// the public port.
+class HealthApiModel
+{
+private:
+    ApiEngine& apiEngine_;
+    SessionApiModel& sessionModel_;
+    SearchWarmUp& warmUp_;
+
+    QTimer signalTimer_;
+    QTimer drainTimer_;
+    QDeadlineTimer drainDeadline_;
+    bool isDrained_ = false;
+
+    std::function<void()> onDrained_;
+
+public:
+    HealthApiModel(ApiEngine& apiEngine, SessionApiModel& sessionModel, SearchWarmUp& warmUp)
+        : apiEngine_(apiEngine)
+        , sessionModel_(sessionModel)
+        , warmUp_(warmUp)
+        , onDrained_([]() { QCoreApplication::quit(); })
+    {
+        drainTimer_.setInterval(DRAIN_POLL_MILLISECONDS);
+        QObject::connect(&drainTimer_, &QTimer::timeout, [this]() { CheckDrain(); });
+
+        signalTimer_.setInterval(DRAIN_POLL_MILLISECONDS);
+        QObject::connect(&signalTimer_, &QTimer::timeout, [this]() { CheckSignal(); });
+    }
+
+    // Starts a drain when the process receives the signal, typically SIGTERM from the supervisor. The handler
+    // only sets a flag, the drain starts on the event loop within DRAIN_POLL_MILLISECONDS.
+    void DrainOnSignal(int signalNumber);
+
+    void OnDrained(std::function<void()> onDrained) { onDrained_ = std::move(onDrained); }
+
+    // Ready once the warm-up has brought search latency to its steady level and until a drain starts
+    bool IsReady() { return warmUp_.IsReady() && sessionModel_.IsDraining() == false; }
+
+    QJsonObject ToJson()
+    {
+        return { { "live", true },
+                 { "ready", IsReady() },
+                 { "draining", sessionModel_.IsDraining() },
+                 { "drained", isDrained_ },
+                 { "sessions", static_cast<int>(sessionModel_.SessionsCount()) },
+                 { "activeSessions", static_cast<int>(sessionModel_.ActiveSessionsCount()) },
+                 { "idleSessions", static_cast<int>(sessionModel_.Sessions().IdleCount()) },
+                 { "reusedSessions", static_cast<qint64>(sessionModel_.Sessions().ReusedCount()) },
+                 { "warmUp", warmUp_.Report() },
+                 { "recorder", sessionModel_.Recorder().ToJson() },
+                 { "result", "ok" } };
+    }
+
+    QJsonObject Topology()
+    {
+        auto topology = sessionModel_.Topology().ToJson();
+        topology["remoteSearches"] = static_cast<qint64>(sessionModel_.CatalogueSearches().RemoteAcquiredCount());
+        topology["result"] = "ok";
+
+        return topology;
+    }
+
+    // Local vs remote memory read bandwidth. The measurement takes a few hundred milliseconds per node pair,
+    // so the first call starts it in the background and later calls get the cached result once it completes
+    QJsonObject MemoryBenchmark()
+    {
+        bool isMeasured = false;
+        auto measurements = sessionModel_.Topology().CachedAccess(isMeasured);
+
+        return { { "measurements", measurements }, { "completed", isMeasured }, { "result", "ok" } };
+    }
+
+    QJsonObject StartDrain(int timeoutSeconds = DRAIN_TIMEOUT_SECONDS)
+    {
+        if (sessionModel_.IsDraining() == false)
+        {
+            sessionModel_.StartDrain();
+
+            // New connections go to the replacement process only, so a session created there is never looked up
+            // here. Connections already open keep being served, the sessions of this process finish on them.
+            apiEngine_.StopListening();
+
+            drainDeadline_.setRemainingTime(static_cast<qint64>(timeoutSeconds) * 1000);
+            drainTimer_.start();
+
+            qInfo() << "Drain started, active sessions: " << sessionModel_.ActiveSessionsCount();
+        }
+
+        return ToJson();
+    }
+
+private:
+    void CheckSignal();
+
+    void CheckDrain()
+    {
+        auto activeSessions = sessionModel_.ActiveSessionsCount();
+
+        if (activeSessions > 0 && drainDeadline_.hasExpired() == false)
+        {
+            return;
+        }
+
+        drainTimer_.stop();
+        isDrained_ = true;
+
+        qInfo() << "Drain finished, sessions left active: " << activeSessions;
+
+        if (onDrained_)
+        {
+            onDrained_();
+        }
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // HEALTHAPIMODEL_H
@@ -0,0 +1,81 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef HEALTHAPIVIEW_H
+#define HEALTHAPIVIEW_H
+
+#include <QJsonObject>
+
+#include "CoreException.h"
+#include "API/IBaseApiView.h"
+#include "API/Health/HealthApiModel.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+// GET health, GET health/live, GET health/ready, GET health/topology, GET health/memory-benchmark
+// Probes which fail answer with an error result, so load balancers take the node out of rotation
+class HealthApiView : public IBaseApiView
+{
+private:
+    HealthApiModel healthModel_;
+
+public:
+    HealthApiView(ApiEngine& apiEngine, SessionApiModel& sessionModel, SearchWarmUp& warmUp)
+        : healthModel_(apiEngine, sessionModel, warmUp)
+    {
+    }
+
+    HealthApiModel& Model() { return healthModel_; }
+
+    QString Name() override { return "HealthApiView"; }
+    QStringList Endpoints() override { return { "health", "health/<arg>" }; }
+
+    QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::Get; }
+
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments& arguments) override
+    {
+        if (arguments.empty() || arguments[0] == "live")
+        {
+            return healthModel_.ToJson();
+        }
+
+        if (arguments[0] == "ready")
+        {
+            if (healthModel_.IsReady() == false)
+            {
+                throw CoreException("Node is warming up, has no steady search latency or is draining and accepts no new sessions");
+            }
+
+            return healthModel_.ToJson();
+        }
+
+        if (arguments[0] == "topology")
+        {
+            return healthModel_.Topology();
+        }
+
+        if (arguments[0] == "memory-benchmark")
+        {
+            return healthModel_.MemoryBenchmark();
+        }
+
+        throw CoreException(QString("Unknown health probe: %1").arg(arguments[0]));
+    }
+
+    QJsonObject Post(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+
+    QJsonObject Put(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // HEALTHAPIVIEW_H
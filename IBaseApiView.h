@@ -10,24 +10,39 @@
 #ifndef BASEAPIVIEW_H
 #define BASEAPIVIEW_H
 
+#include <functional>
+
+#include <QByteArray>
 #include <QHttpServer>
 #include <QJsonObject>
 #include <QString>
 
+#include "RouteArguments.h"
+
 namespace dePhonica::Core::Api {
 
 class IBaseApiView
 {
 public:
+    using DeferredHandler = std::function<QJsonObject()>;
+
     virtual QString Name() = 0;
     virtual QStringList Endpoints() = 0;
 
     virtual QHttpServerRequest::Method MethodsImplemented() = 0;
 
-    virtual QJsonObject Get(const QHttpServerRequest& request, const QStringList& path) = 0;
-    virtual QJsonObject Post(const QHttpServerRequest& request, const QStringList& path) = 0;
-    virtual QJsonObject Put(const QHttpServerRequest& request, const QStringList& path) = 0;
-    virtual QJsonObject Delete(const QHttpServerRequest& request, const QStringList& path) = 0;
+    virtual QJsonObject Get(const QHttpServerRequest& request, const RouteArguments& path) = 0;
+    virtual QJsonObject Post(const QHttpServerRequest& request, const RouteArguments& path) = 0;
+    virtual QJsonObject Put(const QHttpServerRequest& request, const RouteArguments& path) = 0;
+    virtual QJsonObject Delete(const QHttpServerRequest& request, const RouteArguments& path) = 0;
+
+    // Views whose POST blocks for long, like a search, return the work here instead of doing it in Post.
+    // The engine runs it off the event loop thread, so it must capture what it needs from the request.
+    virtual DeferredHandler PostDeferred(const QHttpServerRequest&, const RouteArguments&) { return DeferredHandler(); }
+
+    // Views which keep a response already serialized return it here as compact JSON, for any method.
+    // An empty result falls back to Get, Post, Put or Delete.
+    virtual QByteArray Serialized(const QHttpServerRequest&, const RouteArguments&) { return QByteArray(); }
 };
 
 } // namespace dePhonica::Core::Api
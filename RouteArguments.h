@@ -0,0 +1,44 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef ROUTEARGUMENTS_H
+#define ROUTEARGUMENTS_H
+
+#include <cstddef>
+
+#include <QString>
+
+namespace dePhonica::Core::Api {
+
+// Non-owning view of the <arg> values of a matched route, valid for the duration of one handler call
+class RouteArguments
+{
+private:
+    const QString* arguments_;
+    size_t count_;
+
+public:
+    RouteArguments(const QString* arguments, size_t count)
+        : arguments_(arguments)
+        , count_(count)
+    {
+    }
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    const QString& operator[](size_t index) const { return arguments_[index]; }
+
+    const QString* begin() const { return arguments_; }
+    const QString* end() const { return arguments_ + count_; }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // ROUTEARGUMENTS_H
@@ -0,0 +1,44 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "CatalogueSearch.h"
+
+#include <algorithm>
+
+namespace dePhonica::Core::Api {
+
+CatalogueSearch::CatalogueSearch(const ICoreInstance& coreInstance, size_t workersCount)
+    : coreInstance_(coreInstance)
+    , maxTrackCount_(coreInstance.GetMaxTrackCount())
+    , tracksCompareTo_(std::make_unique<uint8_t[]>(maxTrackCount_))
+    , workers_(SearchHashesWorker::AllocateWorkers(workersCount, coreInstance))
+{
+}
+
+void CatalogueSearch::Search(const std::vector<PeakDescription>& fragmentPeaks, std::vector<LutResult>& searchResult, CatchHistogram* catchHistogram)
+{
+    auto fragmentPeaksGrouped = PeakCompareWorker::GroupPeaks(fragmentPeaks, 1);
+
+    std::fill(tracksCompareTo_.get(), tracksCompareTo_.get() + maxTrackCount_, 1);
+
+    if (catchHistogram != nullptr)
+    {
+        catchHistogram->assign(catchHistogram->size(), 0);
+    }
+
+    SearchHashesWorker::ComparePeaks(workers_, fragmentPeaksGrouped, tracksCompareTo_, maxTrackCount_);
+    SearchHashesWorker::WaitAll(workers_);
+
+    aggregatedResult_.clear();
+    SearchHashesWorker::AggregateResultTracks(workers_, aggregatedResult_, false);
+
+    TopTracks::Select(aggregatedResult_, SEARCH_TOP_TRACKS, searchResult, catchHistogram);
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,64 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef CATALOGUESEARCH_H
+#define CATALOGUESEARCH_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "API/Search/TopTracks.h"
+#include "Engine/Fingerprinter.h"
+#include "Engine/SearchHashesWorker.h"
+#include "Interfaces/ICoreInstance.h"
+
+#define SEARCH_WORKERS_COUNT 80
+// Results kept per search, EstimateApprox works on the catch histogram of all results
+#define SEARCH_TOP_TRACKS 1000
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core::Interfaces;
+using namespace dePhonica::MusicSearch;
+
+using SearchWorkers = decltype(SearchHashesWorker::AllocateWorkers(SEARCH_WORKERS_COUNT, std::declval<const ICoreInstance&>()));
+
+// Compares fragment peaks against the local index with a set of search workers and returns the
+// best SEARCH_TOP_TRACKS results. Every search is one pass over the whole catalogue: the engine compares
+// all peaks in one call, so there is no point to stop at between its workers, and callers check their
+// deadline before they start a search. Not thread safe - one search at a time.
+// The engine's AggregateResultTracks has no bounded variant: it still lists every matched track, so the
+// peak memory and the entries touched per search are the engine's. This class only bounds what is
+// kept - one pass over the list counts the catch histogram and selects the top tracks.
+class CatalogueSearch
+{
+private:
+    const ICoreInstance& coreInstance_;
+
+    size_t maxTrackCount_;
+    std::unique_ptr<uint8_t[]> tracksCompareTo_;
+
+    SearchWorkers workers_;
+
+    // Kept between searches to reuse their storage
+    std::vector<LutResult> aggregatedResult_;
+
+public:
+    CatalogueSearch(const ICoreInstance& coreInstance, size_t workersCount = SEARCH_WORKERS_COUNT);
+
+    size_t MaxTrackCount() const { return maxTrackCount_; }
+
+    // The histogram, if given, is cleared and counts all matched tracks, not only the top ones kept in the result
+    void Search(const std::vector<PeakDescription>& fragmentPeaks, std::vector<LutResult>& searchResult, CatchHistogram* catchHistogram = nullptr);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // CATALOGUESEARCH_H
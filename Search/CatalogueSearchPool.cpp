@@ -0,0 +1,174 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "CatalogueSearchPool.h"
+
+#include <exception>
+#include <thread>
+
+#include <QMutexLocker>
+
+namespace dePhonica::Core::Api {
+
+CatalogueSearchPool::CatalogueSearchPool(const ICoreInstance& coreInstance, const NumaTopology& topology, size_t capacity)
+    : coreInstance_(coreInstance)
+    , topology_(topology)
+    , capacity_(capacity)
+    , idle_(topology.NodesCount())
+    , createdPerNode_(topology.NodesCount())
+{
+}
+
+void CatalogueSearchPool::Prepare()
+{
+    QMutexLocker locker(&lock_);
+
+    for (size_t node = 0; node < idle_.size(); node++)
+    {
+        while (createdPerNode_[node] < NodeCapacity(node))
+        {
+            idle_[node].push_back(CreateOnNode(node));
+            createdPerNode_[node]++;
+            created_++;
+        }
+    }
+}
+
+std::unique_ptr<CatalogueSearch> CatalogueSearchPool::Acquire(size_t preferredNode, size_t& node)
+{
+    QMutexLocker locker(&lock_);
+
+    preferredNode %= idle_.size();
+
+    auto findNode = [this, preferredNode](auto isSuitable, size_t& foundNode) {
+        for (size_t n = 0; n < idle_.size(); n++)
+        {
+            foundNode = (preferredNode + n) % idle_.size();
+            if (isSuitable(foundNode))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    auto isIdle = [this](size_t n) { return idle_[n].empty() == false; };
+    auto isCreatable = [this](size_t n) { return createdPerNode_[n] < NodeCapacity(n); };
+
+    auto createOutsideLock = [this, &locker](size_t n) {
+        createdPerNode_[n]++;
+        created_++;
+
+        // Worker allocation is slow, do it outside of the lock
+        locker.unlock();
+
+        try
+        {
+            return CreateOnNode(n);
+        }
+        catch (...)
+        {
+            locker.relock();
+            createdPerNode_[n]--;
+            created_--;
+            throw;
+        }
+    };
+
+    // Local idle search first, then a new local one, then whatever is idle or can be created elsewhere
+    while (true)
+    {
+        if (isIdle(preferredNode))
+        {
+            node = preferredNode;
+            break;
+        }
+
+        if (isCreatable(preferredNode))
+        {
+            node = preferredNode;
+            return createOutsideLock(node);
+        }
+
+        if (findNode(isIdle, node))
+        {
+            remoteAcquired_++;
+            break;
+        }
+
+        if (findNode(isCreatable, node))
+        {
+            remoteAcquired_++;
+            return createOutsideLock(node);
+        }
+
+        isSearchReleased_.wait(&lock_);
+    }
+
+    auto catalogueSearch = std::move(idle_[node].back());
+    idle_[node].pop_back();
+
+    return catalogueSearch;
+}
+
+void CatalogueSearchPool::Release(std::unique_ptr<CatalogueSearch> catalogueSearch, size_t node)
+{
+    QMutexLocker locker(&lock_);
+
+    idle_[node].push_back(std::move(catalogueSearch));
+    isSearchReleased_.wakeAll();
+}
+
+size_t CatalogueSearchPool::CreatedCount()
+{
+    QMutexLocker locker(&lock_);
+    return created_;
+}
+
+size_t CatalogueSearchPool::RemoteAcquiredCount()
+{
+    QMutexLocker locker(&lock_);
+    return remoteAcquired_;
+}
+
+size_t CatalogueSearchPool::NodeCapacity(size_t node) const
+{
+    auto nodesCount = idle_.size();
+    return capacity_ / nodesCount + (node < capacity_ % nodesCount ? 1 : 0);
+}
+
+std::unique_ptr<CatalogueSearch> CatalogueSearchPool::CreateOnNode(size_t node)
+{
+    std::unique_ptr<CatalogueSearch> catalogueSearch;
+    std::exception_ptr exception;
+
+    // Workers started by a pinned thread inherit its node, the track mask is first touched there
+    std::thread([&]() {
+        topology_.PinCurrentThread(node);
+
+        try
+        {
+            catalogueSearch = std::make_unique<CatalogueSearch>(coreInstance_);
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+    }).join();
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+
+    return catalogueSearch;
+}
+
+} // namespace dePhonica::Core::Api
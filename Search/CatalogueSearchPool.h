@@ -0,0 +1,91 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef CATALOGUESEARCHPOOL_H
+#define CATALOGUESEARCHPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "API/Search/CatalogueSearch.h"
+#include "API/Search/NumaTopology.h"
+#include "API/Search/SearchScheduler.h"
+#include "Interfaces/ICoreInstance.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core::Interfaces;
+
+// Process-wide set of catalogue searches with their worker threads. Holds one search per scheduler slot,
+// so a session which got a slot never waits for a search. Searches are created on first use or by Prepare.
+// Each search belongs to a NUMA node - its workers are pinned there and its buffers are allocated there,
+// sessions get a search of their own node when one is idle.
+class CatalogueSearchPool
+{
+private:
+    QMutex lock_;
+    QWaitCondition isSearchReleased_;
+
+    const ICoreInstance& coreInstance_;
+    const NumaTopology& topology_;
+    size_t capacity_;
+
+    std::vector<std::vector<std::unique_ptr<CatalogueSearch>>> idle_;
+    std::vector<size_t> createdPerNode_;
+    size_t created_ = 0;
+    size_t remoteAcquired_ = 0;
+
+public:
+    CatalogueSearchPool(const ICoreInstance& coreInstance, const NumaTopology& topology, size_t capacity = SEARCH_SCHEDULER_SLOTS);
+
+    // Creates all searches up front, spawning their workers
+    void Prepare();
+
+    // Returns a search and the node it belongs to, preferring the given node
+    std::unique_ptr<CatalogueSearch> Acquire(size_t preferredNode, size_t& node);
+    void Release(std::unique_ptr<CatalogueSearch> catalogueSearch, size_t node);
+
+    size_t Capacity() const { return capacity_; }
+    size_t CreatedCount();
+    size_t RemoteAcquiredCount();
+
+private:
+    // Searches get a fair share of the capacity on every node
+    size_t NodeCapacity(size_t node) const;
+    std::unique_ptr<CatalogueSearch> CreateOnNode(size_t node);
+};
+
+class CatalogueSearchLease
+{
+private:
+    CatalogueSearchPool& pool_;
+    size_t node_ = 0;
+    std::unique_ptr<CatalogueSearch> catalogueSearch_;
+
+public:
+    CatalogueSearchLease(CatalogueSearchPool& pool, size_t preferredNode)
+        : pool_(pool)
+        , catalogueSearch_(pool.Acquire(preferredNode, node_))
+    {
+    }
+
+    ~CatalogueSearchLease() { pool_.Release(std::move(catalogueSearch_), node_); }
+
+    CatalogueSearch* operator->() { return catalogueSearch_.get(); }
+
+    CatalogueSearchLease(const CatalogueSearchLease&) = delete;
+    CatalogueSearchLease& operator=(const CatalogueSearchLease&) = delete;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // CATALOGUESEARCHPOOL_H
@@ -0,0 +1,240 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "NumaTopology.h"
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+
+namespace dePhonica::Core::Api {
+
+NumaTopology::NumaTopology()
+{
+#ifdef Q_OS_LINUX
+    QDir nodesDir("/sys/devices/system/node");
+    auto nodeNames = nodesDir.entryList({ "node*" }, QDir::Dirs);
+
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+
+    for (const auto& nodeName : nodeNames)
+    {
+        bool ok = false;
+        auto nodeIndex = nodeName.mid(4).toInt(&ok);
+
+        QFile cpuListFile(nodesDir.filePath(nodeName + "/cpulist"));
+        if (ok == false || cpuListFile.open(QIODevice::ReadOnly) == false)
+        {
+            continue;
+        }
+
+        auto cpus = ParseCpuList(QString::fromLatin1(cpuListFile.readAll()));
+
+        // Memory-only nodes have no CPUs to pin to
+        if (cpus.empty() == false)
+        {
+            nodes.emplace_back(nodeIndex, std::move(cpus));
+        }
+    }
+
+    std::sort(nodes.begin(), nodes.end());
+
+    for (auto& node : nodes)
+    {
+        nodeCpus_.push_back(std::move(node.second));
+    }
+#endif
+
+    if (nodeCpus_.empty())
+    {
+        nodeCpus_.emplace_back();
+    }
+
+    for (const auto& cpus : nodeCpus_)
+    {
+        for (auto cpu : cpus)
+        {
+            maxCpu_ = std::max(maxCpu_, cpu);
+        }
+    }
+}
+
+NumaTopology::~NumaTopology()
+{
+    if (accessThread_.joinable())
+    {
+        accessThread_.join();
+    }
+}
+
+bool NumaTopology::PinCurrentThread(size_t node) const
+{
+#ifdef Q_OS_LINUX
+    if (nodeCpus_.size() < 2 || node >= nodeCpus_.size() || maxCpu_ < 0)
+    {
+        return false;
+    }
+
+    // Hosts may number CPUs beyond CPU_SETSIZE, so the set is sized for the highest CPU
+    auto cpuSet = CPU_ALLOC(maxCpu_ + 1);
+    if (cpuSet == nullptr)
+    {
+        return false;
+    }
+
+    auto cpuSetSize = CPU_ALLOC_SIZE(maxCpu_ + 1);
+    CPU_ZERO_S(cpuSetSize, cpuSet);
+
+    for (auto cpu : nodeCpus_[node])
+    {
+        CPU_SET_S(cpu, cpuSetSize, cpuSet);
+    }
+
+    auto isPinned = pthread_setaffinity_np(pthread_self(), cpuSetSize, cpuSet) == 0;
+    CPU_FREE(cpuSet);
+
+    return isPinned;
+#else
+    Q_UNUSED(node)
+    return false;
+#endif
+}
+
+QJsonObject NumaTopology::ToJson() const
+{
+    QJsonArray nodes;
+
+    for (size_t n = 0; n < nodeCpus_.size(); n++)
+    {
+        QJsonArray cpus;
+        for (auto cpu : nodeCpus_[n])
+        {
+            cpus.append(cpu);
+        }
+
+        nodes.append(QJsonObject { { "node", static_cast<int>(n) }, { "cpus", cpus } });
+    }
+
+    return { { "nodesCount", static_cast<int>(nodeCpus_.size()) }, { "nodes", nodes } };
+}
+
+QJsonArray NumaTopology::MeasureAccess(size_t bytes) const
+{
+    QJsonArray measurements;
+
+    size_t valuesCount = bytes / sizeof(uint64_t);
+
+    for (size_t memoryNode = 0; memoryNode < nodeCpus_.size(); memoryNode++)
+    {
+        std::unique_ptr<uint64_t[]> buffer;
+
+        // Pages land on the node of the thread which touches them first
+        std::thread([&]() {
+            PinCurrentThread(memoryNode);
+
+            buffer.reset(new uint64_t[valuesCount]);
+            for (size_t n = 0; n < valuesCount; n++)
+            {
+                buffer[n] = n;
+            }
+        }).join();
+
+        for (size_t cpuNode = 0; cpuNode < nodeCpus_.size(); cpuNode++)
+        {
+            qint64 bestNanoseconds = 0;
+            volatile uint64_t checksum = 0;
+
+            std::thread([&]() {
+                PinCurrentThread(cpuNode);
+
+                for (int pass = 0; pass < NUMA_BENCHMARK_PASSES; pass++)
+                {
+                    QElapsedTimer passTimer;
+                    passTimer.start();
+
+                    uint64_t sum = 0;
+                    for (size_t n = 0; n < valuesCount; n++)
+                    {
+                        sum += buffer[n];
+                    }
+
+                    auto nanoseconds = passTimer.nsecsElapsed();
+                    bestNanoseconds = bestNanoseconds == 0 ? nanoseconds : std::min(bestNanoseconds, nanoseconds);
+                    checksum = checksum + sum;
+                }
+            }).join();
+
+            double gigabytesPerSecond = bestNanoseconds > 0 ? static_cast<double>(valuesCount * sizeof(uint64_t)) / bestNanoseconds : 0;
+
+            measurements.append(QJsonObject { { "memoryNode", static_cast<int>(memoryNode) },
+                                              { "cpuNode", static_cast<int>(cpuNode) },
+                                              { "isLocal", memoryNode == cpuNode },
+                                              { "gigabytesPerSecond", gigabytesPerSecond } });
+        }
+    }
+
+    return measurements;
+}
+
+QJsonArray NumaTopology::CachedAccess(bool& isMeasured)
+{
+    std::lock_guard<std::mutex> locker(accessLock_);
+
+    if (accessThread_.joinable() == false)
+    {
+        accessThread_ = std::thread([this]() {
+            auto measurements = MeasureAccess();
+
+            std::lock_guard<std::mutex> locker(accessLock_);
+            accessMeasurements_ = measurements;
+            isAccessMeasured_ = true;
+        });
+    }
+
+    isMeasured = isAccessMeasured_;
+    return accessMeasurements_;
+}
+
+std::vector<int> NumaTopology::ParseCpuList(const QString& cpuList)
+{
+    std::vector<int> cpus;
+
+    for (const auto& range : cpuList.trimmed().split(',', QString::SkipEmptyParts))
+    {
+        auto bounds = range.split('-');
+
+        bool isFirstOk = false, isLastOk = false;
+        int first = bounds[0].toInt(&isFirstOk);
+        int last = bounds.size() > 1 ? bounds[1].toInt(&isLastOk) : first;
+
+        if (isFirstOk == false || (bounds.size() > 1 && isLastOk == false) || first < 0 || last < first || last > NUMA_MAX_CPU)
+        {
+            continue;
+        }
+
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,70 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef NUMATOPOLOGY_H
+#define NUMATOPOLOGY_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+#define NUMA_BENCHMARK_BYTES (64 * 1024 * 1024)
+#define NUMA_BENCHMARK_PASSES 3
+// CPU numbers above this in sysfs are ignored
+#define NUMA_MAX_CPU 65535
+
+namespace dePhonica::Core::Api {
+
+// NUMA nodes of the host and their CPUs as reported by sysfs. Threads pinned to a node allocate
+// their memory there (first touch), and threads they start inherit the pinning. Hosts without NUMA
+// information, or non-Linux hosts, look like one node and pinning does nothing.
+class NumaTopology
+{
+private:
+    std::vector<std::vector<int>> nodeCpus_;
+    int maxCpu_ = -1;
+    std::atomic<size_t> nextNode_ { 0 };
+
+    std::mutex accessLock_;
+    std::thread accessThread_;
+    bool isAccessMeasured_ = false;
+    QJsonArray accessMeasurements_;
+
+public:
+    NumaTopology();
+    ~NumaTopology();
+
+    size_t NodesCount() const { return nodeCpus_.size(); }
+    const std::vector<int>& NodeCpus(size_t node) const { return nodeCpus_[node]; }
+
+    // Round-robin node for a new session
+    size_t NextNode() { return nextNode_++ % nodeCpus_.size(); }
+
+    bool PinCurrentThread(size_t node) const;
+
+    QJsonObject ToJson() const;
+
+    // Read bandwidth of memory placed on each node from the CPUs of each node
+    QJsonArray MeasureAccess(size_t bytes = NUMA_BENCHMARK_BYTES) const;
+
+    // MeasureAccess run once on a background thread, started by the first call. Returns an empty array
+    // until the measurement completes, then its cached result.
+    QJsonArray CachedAccess(bool& isMeasured);
+
+    static std::vector<int> ParseCpuList(const QString& cpuList);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // NUMATOPOLOGY_H
@@ -0,0 +1,114 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SearchScheduler.h"
+
+#include <algorithm>
+
+namespace dePhonica::Core::Api {
+
+SearchScheduler::SearchScheduler(size_t slotsCount)
+    : slotsCount_(slotsCount > 0 ? slotsCount : 1)
+{
+}
+
+void SearchScheduler::Acquire(const QDeadlineTimer& deadline, const QString& clientId, double weight)
+{
+    QMutexLocker locker(&lock_);
+
+    // Queues of clients with waiting searches are never erased, so the reference stays valid
+    auto& client = clients_[clientId];
+    client.Weight = weight > 0 ? weight : 1;
+
+    PendingSearch search { deadline, ticketCounter_++ };
+    client.Pending.push(search);
+    pendingCount_++;
+
+    SelectNext();
+
+    while (slotsBusy_ >= slotsCount_ || nextTicket_ != search.TicketId)
+    {
+        isSlotReleased_.wait(&lock_);
+    }
+
+    // A client which waited idle gets no credit for the time it did not use
+    auto virtualStart = std::max(virtualTime_, client.VirtualFinish);
+    auto cost = client.AverageCost > 0 ? client.AverageCost : averageCost_;
+
+    virtualTime_ = virtualStart;
+    client.VirtualFinish = virtualStart + cost / client.Weight;
+
+    client.Pending.pop();
+    pendingCount_--;
+    slotsBusy_++;
+
+    SelectNext();
+
+    // Another slot may still be free - let the next search check it
+    isSlotReleased_.wakeAll();
+}
+
+void SearchScheduler::Release(const QString& clientId, double costMilliseconds)
+{
+    QMutexLocker locker(&lock_);
+
+    slotsBusy_--;
+
+    averageCost_ = averageCost_ * 0.9 + costMilliseconds * 0.1;
+
+    auto clientIterator = clients_.find(clientId);
+    if (clientIterator != clients_.end())
+    {
+        auto& client = clientIterator->second;
+        client.AverageCost = client.AverageCost > 0 ? client.AverageCost * 0.9 + costMilliseconds * 0.1 : costMilliseconds;
+
+        // Past its virtual finish time an idle client's state no longer affects the order
+        if (client.Pending.empty() && client.VirtualFinish <= virtualTime_)
+        {
+            clients_.erase(clientIterator);
+        }
+    }
+
+    isSlotReleased_.wakeAll();
+}
+
+size_t SearchScheduler::PendingCount()
+{
+    QMutexLocker locker(&lock_);
+    return pendingCount_;
+}
+
+void SearchScheduler::SelectNext()
+{
+    const ClientQueue* next = nullptr;
+    double nextStart = 0;
+
+    for (const auto& entry : clients_)
+    {
+        const auto& client = entry.second;
+
+        if (client.Pending.empty())
+        {
+            continue;
+        }
+
+        auto start = std::max(virtualTime_, client.VirtualFinish);
+
+        // Equal virtual times go to the earlier deadline
+        if (next == nullptr || start < nextStart || (start == nextStart && next->Pending.top() > client.Pending.top()))
+        {
+            next = &client;
+            nextStart = start;
+        }
+    }
+
+    nextTicket_ = next != nullptr ? next->Pending.top().TicketId : std::numeric_limits<uint64_t>::max();
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,127 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SEARCHSCHEDULER_H
+#define SEARCHSCHEDULER_H
+
+#include <limits>
+#include <map>
+#include <queue>
+#include <vector>
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QWaitCondition>
+
+#define SEARCH_SCHEDULER_SLOTS 8
+
+namespace dePhonica::Core::Api {
+
+// Process-wide admission of session searches. At most SEARCH_SCHEDULER_SLOTS searches run at once.
+// Waiting searches are queued per client and clients are served by weighted fair queuing: every grant
+// advances the client's virtual finish time by its average search time divided by its weight, and the
+// next slot goes to the waiting client with the lowest virtual time. A client's own searches are
+// granted earliest-deadline-first. Deadlines only order searches within a client: across clients the
+// order is the fair share alone, so an urgent search of one client waits behind another client whose
+// virtual time is lower.
+class SearchScheduler
+{
+private:
+    struct PendingSearch
+    {
+        QDeadlineTimer Deadline;
+        uint64_t TicketId;
+
+        bool operator>(const PendingSearch& other) const
+        {
+            if (Deadline == other.Deadline)
+            {
+                return TicketId > other.TicketId;
+            }
+
+            return other.Deadline < Deadline;
+        }
+    };
+
+    struct ClientQueue
+    {
+        std::priority_queue<PendingSearch, std::vector<PendingSearch>, std::greater<PendingSearch>> Pending;
+
+        double Weight = 1;
+        double VirtualFinish = 0;
+        double AverageCost = 0;
+    };
+
+    QMutex lock_;
+    QWaitCondition isSlotReleased_;
+
+    size_t slotsCount_;
+    size_t slotsBusy_ = 0;
+    uint64_t ticketCounter_ = 0;
+
+    std::map<QString, ClientQueue> clients_;
+    size_t pendingCount_ = 0;
+
+    // Virtual start time of the last granted search
+    double virtualTime_ = 0;
+    // Average search milliseconds over all clients, the cost of clients without searches yet
+    double averageCost_ = 1;
+
+    // Ticket granted when the next slot frees up
+    uint64_t nextTicket_ = std::numeric_limits<uint64_t>::max();
+
+public:
+    SearchScheduler(size_t slotsCount = SEARCH_SCHEDULER_SLOTS);
+
+    void Acquire(const QDeadlineTimer& deadline, const QString& clientId = QString(), double weight = 1);
+    void Release(const QString& clientId = QString(), double costMilliseconds = 0);
+
+    size_t PendingCount();
+
+private:
+    void SelectNext();
+};
+
+class SearchSlot
+{
+private:
+    SearchScheduler& scheduler_;
+    QString clientId_;
+
+    qint64 waitMicroseconds_;
+    QElapsedTimer runTimer_;
+
+public:
+    SearchSlot(SearchScheduler& scheduler, const QDeadlineTimer& deadline, const QString& clientId = QString(), double weight = 1)
+        : scheduler_(scheduler)
+        , clientId_(clientId)
+    {
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+
+        scheduler_.Acquire(deadline, clientId_, weight);
+
+        waitMicroseconds_ = waitTimer.nsecsElapsed() / 1000;
+        runTimer_.start();
+    }
+
+    ~SearchSlot() { scheduler_.Release(clientId_, static_cast<double>(runTimer_.nsecsElapsed()) / 1e6); }
+
+    qint64 WaitMicroseconds() const { return waitMicroseconds_; }
+
+    SearchSlot(const SearchSlot&) = delete;
+    SearchSlot& operator=(const SearchSlot&) = delete;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SEARCHSCHEDULER_H
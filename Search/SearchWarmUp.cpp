@@ -0,0 +1,244 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SearchWarmUp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+namespace dePhonica::Core::Api {
+
+WarmUpSettings WarmUpSettings::FromEnvironment()
+{
+    WarmUpSettings settings;
+
+    bool ok = false;
+    auto maxSearches = qEnvironmentVariableIntValue("SEARCH_WARMUP_SEARCHES", &ok);
+    if (ok)
+    {
+        settings.MaxSearches = std::max(0, maxSearches);
+        settings.IsEnabled = settings.MaxSearches > 0;
+    }
+
+    auto windowSearches = qEnvironmentVariableIntValue("SEARCH_WARMUP_WINDOW", &ok);
+    if (ok && windowSearches > 0)
+    {
+        settings.WindowSearches = windowSearches;
+    }
+
+    settings.IsReadyWhenUnsteady = qEnvironmentVariableIntValue("SEARCH_WARMUP_READY_UNSTEADY") != 0;
+
+    return settings;
+}
+
+SearchWarmUp::SearchWarmUp(const ICoreInstance& coreInstance, CatalogueSearchPool& catalogueSearches, const WarmUpSettings& settings)
+    : coreInstance_(coreInstance)
+    , catalogueSearches_(catalogueSearches)
+    , settings_(settings)
+{
+}
+
+SearchWarmUp::~SearchWarmUp()
+{
+    if (thread_ != nullptr)
+    {
+        thread_->wait();
+    }
+}
+
+void SearchWarmUp::Start()
+{
+    thread_.reset(QThread::create([this]() { Run(); }));
+    thread_->start();
+}
+
+void SearchWarmUp::Run()
+{
+    QElapsedTimer warmUpTimer;
+    warmUpTimer.start();
+
+    QJsonObject report { { "enabled", settings_.IsEnabled }, { "readyWhenUnsteady", settings_.IsReadyWhenUnsteady } };
+    bool isSteady = settings_.IsEnabled == false;
+
+    if (settings_.IsEnabled)
+    {
+        qInfo() << "Warm-up: spawning search workers";
+        catalogueSearches_.Prepare();
+
+        qInfo() << "Warm-up: touching file name table";
+        report["fileNamesTouched"] = static_cast<qint64>(TouchFileNames());
+
+        auto fragments = GenerateFragments();
+
+        // Every pooled search gets its turn, so all worker sets see the index
+        std::vector<std::unique_ptr<CatalogueSearch>> searches;
+        std::vector<size_t> searchNodes(catalogueSearches_.Capacity());
+
+        for (size_t n = 0; n < searchNodes.size(); n++)
+        {
+            searches.push_back(catalogueSearches_.Acquire(n, searchNodes[n]));
+        }
+
+        std::vector<qint64> latencies;
+        std::vector<LutResult> searchResult;
+        qint64 previousWindowP99 = -1;
+        qint64 windowP99 = -1;
+
+        for (int n = 0; n < settings_.MaxSearches && isSteady == false && fragments.empty() == false; n++)
+        {
+            QElapsedTimer searchTimer;
+            searchTimer.start();
+
+            searches[n % searches.size()]->Search(fragments[n % fragments.size()], searchResult);
+
+            latencies.push_back(searchTimer.elapsed());
+
+            if (latencies.size() % settings_.WindowSearches == 0)
+            {
+                windowP99 = Percentile99(std::vector<qint64>(latencies.end() - settings_.WindowSearches, latencies.end()));
+
+                isSteady = previousWindowP99 >= 0 && windowP99 >= previousWindowP99 / WARMUP_STEADY_TOLERANCE;
+                previousWindowP99 = windowP99;
+            }
+        }
+
+        for (size_t n = 0; n < searches.size(); n++)
+        {
+            catalogueSearches_.Release(std::move(searches[n]), searchNodes[n]);
+        }
+
+        report["searches"] = static_cast<qint64>(latencies.size());
+        report["firstSearchMilliseconds"] = latencies.empty() ? 0 : latencies.front();
+        report["p99Milliseconds"] = windowP99;
+        report["isSteady"] = isSteady;
+
+        qInfo() << "Warm-up: searches" << latencies.size() << "p99" << windowP99 << "ms, steady:" << isSteady;
+
+        if (isSteady == false && settings_.IsReadyWhenUnsteady == false)
+        {
+            qWarning() << "Warm-up: latency did not become steady, the node stays not ready";
+        }
+    }
+
+    report["elapsedMilliseconds"] = warmUpTimer.elapsed();
+
+    QMutexLocker locker(&lock_);
+    report_ = report;
+    isCompleted_ = true;
+    isSteady_ = isSteady;
+}
+
+bool SearchWarmUp::IsCompleted()
+{
+    QMutexLocker locker(&lock_);
+    return isCompleted_;
+}
+
+bool SearchWarmUp::IsReady()
+{
+    QMutexLocker locker(&lock_);
+    return isCompleted_ && (isSteady_ || settings_.IsReadyWhenUnsteady);
+}
+
+QJsonObject SearchWarmUp::Report()
+{
+    QMutexLocker locker(&lock_);
+
+    auto report = report_;
+    report["completed"] = isCompleted_;
+    report["ready"] = isCompleted_ && (isSteady_ || settings_.IsReadyWhenUnsteady);
+
+    return report;
+}
+
+size_t SearchWarmUp::TouchFileNames()
+{
+    size_t maxTrackCount = coreInstance_.GetMaxTrackCount();
+    size_t touched = 0;
+
+    // One lookup per stride is enough to fault in the pages of the table
+    for (size_t n = 0; n < maxTrackCount; n += WARMUP_FILE_NAME_STRIDE, touched++)
+    {
+        coreInstance_.GetFileNameByIndex(n);
+    }
+
+    return touched;
+}
+
+std::vector<std::vector<PeakDescription>> SearchWarmUp::GenerateFragments()
+{
+    MusicSettings musicSettings;
+    Fingerprinter fingerprinter(musicSettings);
+
+    size_t samplesCount = static_cast<size_t>(WARMUP_FRAGMENT_SECONDS) * musicSettings.TargetSampleRate;
+    std::vector<float> samples(samplesCount);
+
+    SingleBuffer<float> fragmentBuffer("Warm-up fragment buffer", samplesCount);
+    std::vector<std::vector<PeakDescription>> fragments;
+
+    std::mt19937 generator(WARMUP_FRAGMENTS_COUNT);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    std::uniform_real_distribution<float> frequency(100.0f, 4000.0f);
+
+    // Tone chords over noise give peaks spread across bands and chunks, like music does
+    for (size_t fragment = 0; fragment < WARMUP_FRAGMENTS_COUNT; fragment++)
+    {
+        float tones[4];
+        for (auto& tone : tones)
+        {
+            tone = frequency(generator);
+        }
+
+        for (size_t n = 0; n < samplesCount; n++)
+        {
+            if (n % musicSettings.TargetSampleRate == 0)
+            {
+                tones[(n / musicSettings.TargetSampleRate) % 4] = frequency(generator);
+            }
+
+            float value = noise(generator);
+            for (auto tone : tones)
+            {
+                value += 0.2f * std::sin(2.0f * static_cast<float>(M_PI) * tone * n / musicSettings.TargetSampleRate);
+            }
+
+            samples[n] = value;
+        }
+
+        fragmentBuffer.Copy(samples.data(), samplesCount, musicSettings.TargetSampleRate);
+        fragmentBuffer.DataLengthSamples(samplesCount);
+
+        fingerprinter.Generate(fragmentBuffer);
+        auto fragmentPeaks = fingerprinter.PeaksCollection();
+        fragments.emplace_back(fragmentPeaks.begin(), fragmentPeaks.end());
+    }
+
+    return fragments;
+}
+
+qint64 SearchWarmUp::Percentile99(std::vector<qint64> latencies)
+{
+    if (latencies.empty())
+    {
+        return 0;
+    }
+
+    auto index = static_cast<size_t>(std::ceil(latencies.size() * 0.99)) - 1;
+    std::nth_element(latencies.begin(), latencies.begin() + index, latencies.end());
+
+    return latencies[index];
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,92 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SEARCHWARMUP_H
+#define SEARCHWARMUP_H
+
+#include <memory>
+#include <vector>
+
+#include <QJsonObject>
+#include <QMutex>
+#include <QThread>
+
+#include "API/Search/CatalogueSearchPool.h"
+#include "Engine/Fingerprinter.h"
+#include "Interfaces/ICoreInstance.h"
+
+#define WARMUP_MAX_SEARCHES 64
+#define WARMUP_WINDOW_SEARCHES 8
+// Latency is steady once a window p99 is no longer below the previous window p99 divided by this factor
+#define WARMUP_STEADY_TOLERANCE 1.2
+#define WARMUP_FRAGMENT_SECONDS 10
+#define WARMUP_FRAGMENTS_COUNT 4
+#define WARMUP_FILE_NAME_STRIDE 256
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core::Interfaces;
+using namespace dePhonica::MusicSearch;
+
+struct WarmUpSettings
+{
+    bool IsEnabled = true;
+    int MaxSearches = WARMUP_MAX_SEARCHES;
+    int WindowSearches = WARMUP_WINDOW_SEARCHES;
+    // Gives up on steady latency: a warm-up which runs out of searches still makes the node ready
+    bool IsReadyWhenUnsteady = false;
+
+    // SEARCH_WARMUP_SEARCHES=0 disables the warm-up
+    static WarmUpSettings FromEnvironment();
+};
+
+// Brings a fresh node to steady-state latency: spawns the workers of every pooled catalogue search,
+// faults in the file name table and runs synthetic searches over the whole index until the p99 latency
+// of consecutive windows stops falling. Runs on its own thread while the node already listens, so the
+// health probes answer and report the node not ready until it completes. A warm-up which runs out of
+// searches before the latency is steady leaves the node not ready, unless IsReadyWhenUnsteady is set.
+class SearchWarmUp
+{
+private:
+    QMutex lock_;
+
+    const ICoreInstance& coreInstance_;
+    CatalogueSearchPool& catalogueSearches_;
+    WarmUpSettings settings_;
+
+    bool isCompleted_ = false;
+    bool isSteady_ = false;
+    QJsonObject report_;
+
+    std::unique_ptr<QThread> thread_;
+
+public:
+    SearchWarmUp(const ICoreInstance& coreInstance, CatalogueSearchPool& catalogueSearches, const WarmUpSettings& settings);
+    ~SearchWarmUp();
+
+    // Runs the warm-up on a background thread
+    void Start();
+
+    void Run();
+
+    bool IsCompleted();
+    // Completed with steady latency, or without the warm-up, or given up on by the settings
+    bool IsReady();
+    QJsonObject Report();
+
+private:
+    size_t TouchFileNames();
+    std::vector<std::vector<PeakDescription>> GenerateFragments();
+
+    static qint64 Percentile99(std::vector<qint64> latencies);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SEARCHWARMUP_H
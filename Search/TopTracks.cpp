@@ -0,0 +1,126 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "TopTracks.h"
+
+#include <algorithm>
+#include <queue>
+
+namespace dePhonica::Core::Api {
+
+std::vector<LutResult> TopTracks::Select(const std::vector<LutResult>& results, size_t k)
+{
+    std::vector<LutResult> heap;
+    Select(results, k, heap);
+
+    return heap;
+}
+
+void TopTracks::Select(const std::vector<LutResult>& results, size_t k, std::vector<LutResult>& heap, CatchHistogram* catchHistogram)
+{
+    heap.clear();
+    heap.reserve(std::min(k, results.size()));
+
+    // With IsBetter as the ordering the heap front is the worst of the kept results
+    for (const auto& result : results)
+    {
+        if (catchHistogram != nullptr)
+        {
+            size_t catches = result.Catches;
+            if (catches >= catchHistogram->size())
+            {
+                catchHistogram->resize(catches + 1);
+            }
+
+            (*catchHistogram)[catches]++;
+        }
+
+        if (k == 0)
+        {
+            continue;
+        }
+
+        if (heap.size() < k)
+        {
+            heap.push_back(result);
+            std::push_heap(heap.begin(), heap.end(), IsBetter);
+        }
+        else if (IsBetter(result, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), IsBetter);
+            heap.back() = result;
+            std::push_heap(heap.begin(), heap.end(), IsBetter);
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), IsBetter);
+}
+
+std::vector<LutResult> TopTracks::Merge(const std::vector<std::vector<LutResult>>& partialResults, size_t k)
+{
+    std::vector<LutResult> merged;
+    Merge(partialResults, k, merged);
+
+    return merged;
+}
+
+void TopTracks::Merge(const std::vector<std::vector<LutResult>>& partialResults, size_t k, std::vector<LutResult>& merged)
+{
+    struct Cursor
+    {
+        size_t ListIndex;
+        size_t Position;
+    };
+
+    auto isWorse = [&partialResults](const Cursor& a, const Cursor& b) {
+        return IsBetter(partialResults[b.ListIndex][b.Position], partialResults[a.ListIndex][a.Position]);
+    };
+
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(isWorse)> cursors(isWorse);
+
+    for (size_t n = 0; n < partialResults.size(); n++)
+    {
+        if (partialResults[n].empty() == false)
+        {
+            cursors.push({ n, 0 });
+        }
+    }
+
+    merged.clear();
+    merged.reserve(k);
+
+    while (merged.size() < k && cursors.empty() == false)
+    {
+        auto cursor = cursors.top();
+        cursors.pop();
+
+        const auto& list = partialResults[cursor.ListIndex];
+        merged.push_back(list[cursor.Position]);
+
+        if (++cursor.Position < list.size())
+        {
+            cursors.push(cursor);
+        }
+    }
+}
+
+void TopTracks::AddHistogram(const CatchHistogram& partial, CatchHistogram& total)
+{
+    if (partial.size() > total.size())
+    {
+        total.resize(partial.size());
+    }
+
+    for (size_t catches = 0; catches < partial.size(); catches++)
+    {
+        total[catches] += partial[catches];
+    }
+}
+
+} // namespace dePhonica::Core::Api
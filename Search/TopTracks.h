@@ -0,0 +1,51 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef TOPTRACKS_H
+#define TOPTRACKS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Engine/SearchHashesWorker.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::MusicSearch;
+
+// Number of matched tracks per catch count over the whole catalogue, indexed by the catch count
+using CatchHistogram = std::vector<uint32_t>;
+
+// Bounded top-K selection of search results. Partial result lists are reduced with a k-sized heap each
+// and then k-way merged, so a search never sorts or keeps more than k entries per partial list.
+class TopTracks
+{
+public:
+    static bool IsBetter(const LutResult& a, const LutResult& b)
+    {
+        return a.Catches > b.Catches || (a.Catches == b.Catches && a.TrackIndex < b.TrackIndex);
+    }
+
+    // Returns the k best results, best first
+    static std::vector<LutResult> Select(const std::vector<LutResult>& results, size_t k);
+    // Same, reusing the storage of the output vector. Counts every result into the histogram, if given, in the same pass.
+    static void Select(const std::vector<LutResult>& results, size_t k, std::vector<LutResult>& heap, CatchHistogram* catchHistogram = nullptr);
+
+    // Merges lists sorted best first into the k best results, best first
+    static std::vector<LutResult> Merge(const std::vector<std::vector<LutResult>>& partialResults, size_t k);
+    static void Merge(const std::vector<std::vector<LutResult>>& partialResults, size_t k, std::vector<LutResult>& merged);
+
+    // Adds the counts of one histogram to another
+    static void AddHistogram(const CatchHistogram& partial, CatchHistogram& total);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // TOPTRACKS_H
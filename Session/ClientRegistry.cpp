@@ -0,0 +1,169 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "ClientRegistry.h"
+
+#include <algorithm>
+
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QProcessEnvironment>
+
+#include "CoreException.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+ClientSettings ClientSettings::FromEnvironment()
+{
+    auto environment = QProcessEnvironment::systemEnvironment();
+
+    ClientSettings settings;
+    settings.PushRate = environment.value("CLIENT_PUSH_RATE", "0").toDouble();
+    settings.PushBurst = environment.value("CLIENT_PUSH_BURST", "0").toDouble();
+    settings.SearchRate = environment.value("CLIENT_SEARCH_RATE", "0").toDouble();
+    settings.SearchBurst = environment.value("CLIENT_SEARCH_BURST", "0").toDouble();
+
+    for (const auto& definition : environment.value("CLIENT_WEIGHTS").split(',', QString::SkipEmptyParts))
+    {
+        auto parts = definition.split('=');
+        bool ok = false;
+        auto weight = parts.size() == 2 ? parts[1].toDouble(&ok) : 0;
+
+        if (ok && weight > 0)
+        {
+            settings.Weights[parts[0].trimmed()] = weight;
+        }
+    }
+
+    return settings;
+}
+
+ClientAccount::ClientAccount(const QString& id, double weight, const ClientSettings& settings)
+    : id_(id)
+    , weight_(weight)
+    , pushes_(settings.PushRate, settings.PushBurst)
+    , searches_(settings.SearchRate, settings.SearchBurst)
+{
+}
+
+bool ClientAccount::TryPush(size_t bytes)
+{
+    QMutexLocker locker(&lock_);
+
+    if (pushes_.TryTake() == false)
+    {
+        pushesRejected_++;
+        return false;
+    }
+
+    pushesAccepted_++;
+    bytesPushed_ += bytes;
+
+    return true;
+}
+
+bool ClientAccount::TrySearch()
+{
+    QMutexLocker locker(&lock_);
+
+    if (searches_.TryTake() == false)
+    {
+        searchesThrottled_++;
+        return false;
+    }
+
+    return true;
+}
+
+void ClientAccount::AddSearch(uint64_t waitMicroseconds, uint64_t searchMicroseconds)
+{
+    searchesRun_++;
+    searchWaitMicroseconds_ += waitMicroseconds;
+    searchMicroseconds_ += searchMicroseconds;
+}
+
+QJsonObject ClientAccount::ToJson()
+{
+    QMutexLocker locker(&lock_);
+
+    auto searchesRun = searchesRun_.load();
+
+    return { { "clientId", id_ },
+             { "weight", weight_ },
+             { "sessions", static_cast<qint64>(sessions_.load()) },
+             { "pushesAccepted", static_cast<qint64>(pushesAccepted_.load()) },
+             { "pushesRejected", static_cast<qint64>(pushesRejected_.load()) },
+             { "bytesPushed", static_cast<qint64>(bytesPushed_.load()) },
+             { "pushTokens", pushes_.IsLimited() ? QJsonValue(pushes_.Tokens()) : QJsonValue() },
+             { "searchesRun", static_cast<qint64>(searchesRun) },
+             { "searchesThrottled", static_cast<qint64>(searchesThrottled_.load()) },
+             { "searchTokens", searches_.IsLimited() ? QJsonValue(searches_.Tokens()) : QJsonValue() },
+             { "searchMs", static_cast<double>(searchMicroseconds_.load()) / 1000 },
+             { "averageSearchWaitMs", searchesRun > 0 ? static_cast<double>(searchWaitMicroseconds_.load()) / 1000 / searchesRun : 0.0 } };
+}
+
+ClientRegistry::ClientRegistry(const ClientSettings& settings)
+    : settings_(settings)
+{
+}
+
+ClientAccount& ClientRegistry::Acquire(const QString& clientId)
+{
+    QMutexLocker locker(&lock_);
+
+    auto accountIterator = accounts_.find(clientId);
+
+    if (accountIterator == accounts_.end())
+    {
+        if (accounts_.size() >= CLIENTS_MAX_COUNT)
+        {
+            auto idleAccount = std::find_if(accounts_.begin(), accounts_.end(), [](const auto& account) { return account.second->sessions_ == 0; });
+
+            if (idleAccount == accounts_.end())
+            {
+                throw CoreException(QString("Unable to register the client - more than %1 clients have sessions").arg(CLIENTS_MAX_COUNT));
+            }
+
+            accounts_.erase(idleAccount);
+        }
+
+        auto account = std::make_unique<ClientAccount>(clientId, settings_.Weights.value(clientId, 1.0), settings_);
+        accountIterator = accounts_.emplace(clientId, std::move(account)).first;
+    }
+
+    accountIterator->second->sessions_++;
+
+    return *accountIterator->second;
+}
+
+void ClientRegistry::Release(ClientAccount& account)
+{
+    QMutexLocker locker(&lock_);
+    account.sessions_--;
+}
+
+QJsonObject ClientRegistry::ToJson()
+{
+    QMutexLocker locker(&lock_);
+
+    QJsonArray clients;
+    for (auto& account : accounts_)
+    {
+        clients.append(account.second->ToJson());
+    }
+
+    return { { "pushRate", settings_.PushRate },
+             { "searchRate", settings_.SearchRate },
+             { "clients", clients },
+             { "result", "ok" } };
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,103 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef CLIENTREGISTRY_H
+#define CLIENTREGISTRY_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include "API/Session/TokenBucket.h"
+
+#define CLIENT_ID_HEADER "X-Client-Id"
+#define CLIENT_DEFAULT_ID "anonymous"
+// Accounts kept at once, accounts without sessions are evicted to make room
+#define CLIENTS_MAX_COUNT 10000
+
+namespace dePhonica::Core::Api {
+
+// Limits applied to every client, zero rates disable a limit
+struct ClientSettings
+{
+    double PushRate = 0;
+    double PushBurst = 0;
+    double SearchRate = 0;
+    double SearchBurst = 0;
+
+    // Search share of a client relative to the others, clients not listed have weight 1
+    QMap<QString, double> Weights;
+
+    // CLIENT_PUSH_RATE, CLIENT_PUSH_BURST, CLIENT_SEARCH_RATE, CLIENT_SEARCH_BURST per second,
+    // CLIENT_WEIGHTS as "client=weight,client=weight"
+    static ClientSettings FromEnvironment();
+};
+
+// Rate limits and consumption of one client across all of its sessions
+class ClientAccount
+{
+private:
+    friend class ClientRegistry;
+
+    QString id_;
+    double weight_;
+
+    QMutex lock_;
+    TokenBucket pushes_;
+    TokenBucket searches_;
+
+    std::atomic<uint64_t> sessions_ { 0 };
+    std::atomic<uint64_t> pushesAccepted_ { 0 }, pushesRejected_ { 0 }, bytesPushed_ { 0 };
+    std::atomic<uint64_t> searchesRun_ { 0 }, searchesThrottled_ { 0 };
+    std::atomic<uint64_t> searchMicroseconds_ { 0 }, searchWaitMicroseconds_ { 0 };
+
+public:
+    ClientAccount(const QString& id, double weight, const ClientSettings& settings);
+
+    const QString& Id() const { return id_; }
+    double Weight() const { return weight_; }
+
+    // Takes a push token, false when the client pushes faster than its limit
+    bool TryPush(size_t bytes);
+
+    // Takes a search token, false when the session should skip this search
+    bool TrySearch();
+
+    void AddSearch(uint64_t waitMicroseconds, uint64_t searchMicroseconds);
+
+    QJsonObject ToJson();
+};
+
+// Client accounts by client identity, the "clientId" of the session definition
+class ClientRegistry
+{
+private:
+    QMutex lock_;
+
+    ClientSettings settings_;
+    std::map<QString, std::unique_ptr<ClientAccount>> accounts_;
+
+public:
+    ClientRegistry(const ClientSettings& settings = ClientSettings::FromEnvironment());
+
+    // Counts a session of the client, the account stays valid until the matching Release
+    ClientAccount& Acquire(const QString& clientId);
+    void Release(ClientAccount& account);
+
+    QJsonObject ToJson();
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // CLIENTREGISTRY_H
@@ -0,0 +1,189 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SampleChunkList.h"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+
+namespace dePhonica::Core::Api {
+
+void SampleView::CopyTo(float* destination, size_t from, size_t count) const
+{
+    count = from < length_ ? std::min(count, length_ - from) : 0;
+
+    while (count > 0)
+    {
+        auto chunkOffset = from % chunkSamples_;
+        auto piece = std::min(count, chunkSamples_ - chunkOffset);
+
+        std::copy(chunks_[from / chunkSamples_] + chunkOffset, chunks_[from / chunkSamples_] + chunkOffset + piece, destination);
+
+        destination += piece;
+        from += piece;
+        count -= piece;
+    }
+}
+
+const float* SampleView::Contiguous(size_t from, size_t count)
+{
+    if (count > 0 && from / chunkSamples_ == (from + count - 1) / chunkSamples_)
+    {
+        return chunks_[from / chunkSamples_] + from % chunkSamples_;
+    }
+
+    gathered_.resize(count);
+    CopyTo(gathered_.data(), from, count);
+
+    return gathered_.data();
+}
+
+SampleChunkList::SampleChunkList(size_t chunkSamples)
+    : chunkSamples_(chunkSamples)
+{
+}
+
+void SampleChunkList::Append(const float* samples, size_t count)
+{
+    QMutexLocker appendLocker(&appendLock_);
+
+    auto length = length_.load(std::memory_order_relaxed);
+    auto lengthAppended = length + count;
+
+    {
+        QMutexLocker chunksLocker(&chunksLock_);
+
+        while (chunks_.size() * chunkSamples_ < lengthAppended)
+        {
+            chunks_.push_back(std::make_unique<float[]>(chunkSamples_));
+        }
+    }
+
+    // Samples past the published length are invisible to readers, write them without the chunks lock
+    while (count > 0)
+    {
+        auto chunkOffset = length % chunkSamples_;
+        auto piece = std::min(count, chunkSamples_ - chunkOffset);
+
+        std::copy(samples, samples + piece, chunks_[length / chunkSamples_].get() + chunkOffset);
+
+        samples += piece;
+        length += piece;
+        count -= piece;
+    }
+
+    length_.store(lengthAppended, std::memory_order_release);
+}
+
+float* SampleChunkList::PrepareAppend(size_t maxCount)
+{
+    QMutexLocker appendLocker(&appendLock_);
+
+    auto length = length_.load(std::memory_order_relaxed);
+
+    isStaged_ = length / chunkSamples_ != (length + std::max<size_t>(maxCount, 1) - 1) / chunkSamples_;
+    if (isStaged_)
+    {
+        staging_.resize(maxCount);
+        return staging_.data();
+    }
+
+    QMutexLocker chunksLocker(&chunksLock_);
+
+    if (chunks_.size() * chunkSamples_ <= length)
+    {
+        chunks_.push_back(std::make_unique<float[]>(chunkSamples_));
+    }
+
+    return chunks_[length / chunkSamples_].get() + length % chunkSamples_;
+}
+
+const float* SampleChunkList::CommitAppend(size_t count)
+{
+    if (isStaged_)
+    {
+        Append(staging_.data(), count);
+        return staging_.data();
+    }
+
+    QMutexLocker appendLocker(&appendLock_);
+
+    auto length = length_.load(std::memory_order_relaxed);
+    length_.store(length + count, std::memory_order_release);
+
+    QMutexLocker chunksLocker(&chunksLock_);
+    return chunks_[length / chunkSamples_].get() + length % chunkSamples_;
+}
+
+void SampleChunkList::Reserve()
+{
+    QMutexLocker appendLocker(&appendLock_);
+    QMutexLocker chunksLocker(&chunksLock_);
+
+    if (chunks_.empty())
+    {
+        chunks_.push_back(std::make_unique<float[]>(chunkSamples_));
+    }
+}
+
+void SampleChunkList::ReserveAhead(size_t count)
+{
+    // Chunks are allocated outside the locks, an append running meanwhile must not wait for the zeroing
+    if (Length() + count <= AllocatedBytes() / sizeof(float))
+    {
+        return;
+    }
+
+    auto chunk = std::make_unique<float[]>(chunkSamples_);
+
+    // The appender reads the chunk vector without the chunks lock, only under its own
+    QMutexLocker appendLocker(&appendLock_);
+    QMutexLocker chunksLocker(&chunksLock_);
+
+    if (Length() + count > chunks_.size() * chunkSamples_)
+    {
+        chunks_.push_back(std::move(chunk));
+    }
+}
+
+void SampleChunkList::Reset()
+{
+    QMutexLocker appendLocker(&appendLock_);
+    QMutexLocker chunksLocker(&chunksLock_);
+
+    if (chunks_.size() > 1)
+    {
+        chunks_.resize(1);
+    }
+
+    length_.store(0, std::memory_order_release);
+}
+
+size_t SampleChunkList::AllocatedBytes() const
+{
+    QMutexLocker chunksLocker(&chunksLock_);
+    return chunks_.size() * chunkSamples_ * sizeof(float);
+}
+
+void SampleChunkList::View(SampleView& view) const
+{
+    QMutexLocker chunksLocker(&chunksLock_);
+
+    view.chunkSamples_ = chunkSamples_;
+    view.length_ = length_.load(std::memory_order_acquire);
+
+    view.chunks_.resize(chunks_.size());
+    for (size_t n = 0; n < chunks_.size(); n++)
+    {
+        view.chunks_[n] = chunks_[n].get();
+    }
+}
+
+} // namespace dePhonica::Core::Api
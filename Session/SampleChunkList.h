@@ -0,0 +1,97 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SAMPLECHUNKLIST_H
+#define SAMPLECHUNKLIST_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+
+// One minute at the target sample rate, sessions shorter than that live in a single chunk
+#define SAMPLE_CHUNK_SAMPLES (16000 * 60)
+
+namespace dePhonica::Core::Api {
+
+class SampleChunkList;
+
+// Read-only view of the samples a chunk list held when the view was taken. Reading it needs no lock,
+// samples below the view length are never written again. Valid while the chunk list lives.
+class SampleView
+{
+private:
+    friend class SampleChunkList;
+
+    std::vector<const float*> chunks_;
+    size_t chunkSamples_ = 0;
+    size_t length_ = 0;
+
+    std::vector<float> gathered_;
+
+public:
+    size_t Length() const { return length_; }
+
+    void CopyTo(float* destination, size_t from, size_t count) const;
+
+    // Points straight into the chunk when the range lies in one, otherwise gathers the range
+    // into storage of the view which stays valid until the next call
+    const float* Contiguous(size_t from, size_t count);
+};
+
+// Append-only list of fixed-size sample chunks. Chunks never move and written samples never change,
+// so readers take views while samples are appended. Appends are serialized.
+class SampleChunkList
+{
+private:
+    QMutex appendLock_;
+    mutable QMutex chunksLock_;
+
+    size_t chunkSamples_;
+    std::vector<std::unique_ptr<float[]>> chunks_;
+    std::atomic<size_t> length_ { 0 };
+
+    // Storage of a prepared append which does not fit the current chunk
+    std::vector<float> staging_;
+    bool isStaged_ = false;
+
+public:
+    SampleChunkList(size_t chunkSamples = SAMPLE_CHUNK_SAMPLES);
+
+    void Append(const float* samples, size_t count);
+
+    // Appends in place: PrepareAppend returns storage for up to maxCount samples, CommitAppend publishes the
+    // first count of them and returns where they are. The storage is the free tail of the last chunk when the
+    // samples fit there, otherwise reused staging storage copied into the chunks on commit. Other appends
+    // may not run between the two calls - the list has a single writer.
+    float* PrepareAppend(size_t maxCount);
+    const float* CommitAppend(size_t count);
+
+    // Allocates the first chunk ahead of the first append
+    void Reserve();
+    // Allocates the next chunk once fewer than count samples are free, so the calling thread first touches
+    // it instead of the appending one. Appends which outrun it still allocate for themselves.
+    void ReserveAhead(size_t count);
+
+    // Drops all samples but keeps the first chunk for reuse. No view may be read afterwards
+    void Reset();
+
+    size_t Length() const { return length_.load(std::memory_order_acquire); }
+
+    // Bytes of all chunks allocated so far
+    size_t AllocatedBytes() const;
+
+    // Refreshes the view, reusing its storage
+    void View(SampleView& view) const;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SAMPLECHUNKLIST_H
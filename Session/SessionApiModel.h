@@ -10,19 +10,36 @@
 #ifndef SESSIONAPIMODEL_H
 #define SESSIONAPIMODEL_H
 
+#include <algorithm>
 #include <map>
 #include <memory>
+#include <vector>
 
+#include <QCryptographicHash>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QUuid>
 
+#include "API/Search/CatalogueSearchPool.h"
+#include "API/Search/NumaTopology.h"
+#include "API/Search/SearchScheduler.h"
 #include "API/Session/SessionModel.h"
+#include "API/Session/SessionPool.h"
+#include "API/Session/SessionServices.h"
+#include "API/Session/SessionSnapshot.h"
+#include "API/Session/SharedSearchRegistry.h"
+#include "API/Session/TrackNameCache.h"
+#include "API/Shards/ShardSettings.h"
 #include "CoreException.h"
 #include "Interfaces/ICoreInstance.h"
 
+#define SESSION_BATCH_MAX_ITEMS 1000
+#define SESSION_TOP_DEFAULT_COUNT 20
+#define SESSION_ID_HEX_DIGITS 16
+
 namespace dePhonica::Core::Api {
 
 using namespace dePhonica::Core;
@@ -34,50 +51,111 @@ private:
     QMutex lock_;
 
     ICoreInstance& coreInstance_;
+    SearchScheduler searchScheduler_;
+    NumaTopology topology_;
+    CatalogueSearchPool catalogueSearches_;
+    TrackNameCache trackNames_;
+    SharedSearchRegistry sharedSearches_;
+    SessionRecorder recorder_;
+    ClientRegistry clients_;
+    const ShardSettings shardSettings_;
+
+    SessionServices services_;
+    SessionPool sessionPool_;
+
+    // Requests hold a session by shared ownership and work on it outside the registry lock, the last
+    // owner of a deleted session returns it to the pool
+    std::map<QString, std::shared_ptr<SessionModel>> sessions_;
+
+    // A draining node keeps serving its sessions but accepts no new ones
+    bool isDraining_ = false;
+
+    std::shared_ptr<SessionModel> Share(std::unique_ptr<SessionModel> session)
+    {
+        return std::shared_ptr<SessionModel>(session.release(), [this](SessionModel* released) {
+            sessionPool_.Release(std::unique_ptr<SessionModel>(released));
+        });
+    }
+
+    std::shared_ptr<SessionModel> FindSession(const QString& sessionToken)
+    {
+        QMutexLocker locker(&lock_);
 
-    std::map<QString, std::unique_ptr<SessionModel>> sessions_;
+        auto sessionIterator = sessions_.find(sessionToken);
+        return sessionIterator != sessions_.end() ? sessionIterator->second : nullptr;
+    }
 
 public:
-    SessionApiModel(ICoreInstance& coreInstance)
+    SessionApiModel(ICoreInstance& coreInstance, const ShardSettings& shardSettings)
         : lock_(QMutex::Recursive)
         , coreInstance_(coreInstance)
+        , catalogueSearches_(coreInstance, topology_)
+        , trackNames_(coreInstance)
+        , shardSettings_(shardSettings)
+        , services_ { coreInstance_, searchScheduler_, topology_, catalogueSearches_, trackNames_, sharedSearches_, recorder_, clients_, shardSettings_ }
+        , sessionPool_(services_)
     {
     }
 
+    SessionServices& Services() { return services_; }
+    CatalogueSearchPool& CatalogueSearches() { return catalogueSearches_; }
+    NumaTopology& Topology() { return topology_; }
+    SessionPool& Sessions() { return sessionPool_; }
+    const SessionRecorder& Recorder() const { return recorder_; }
+    ClientRegistry& Clients() { return clients_; }
+
+    // Builds the idle sessions ahead of the first requests
+    void Prepare() { sessionPool_.Prepare(); }
+
     QJsonObject CreateSession(const QJsonObject& sessionInfo)
     {
-        QMutexLocker locker(&lock_);
+        if (IsDraining())
+        {
+            throw CoreException("Unable to create a session - the node is draining");
+        }
 
+        // Configuring the session designs its resampling filter, which must not stall other requests
+        auto session = sessionPool_.Acquire(sessionInfo);
         auto token = QUuid::createUuid().toString();
-        sessions_[token] = std::make_unique<SessionModel>(coreInstance_, sessionInfo);
+
+        QMutexLocker locker(&lock_);
+        sessions_[token] = Share(std::move(session));
 
         return { { "token", token }, { "result", "ok" } };
     }
 
     QJsonObject DeleteSession(const QString sessionToken)
     {
-        QMutexLocker locker(&lock_);
+        std::shared_ptr<SessionModel> session;
 
-        auto sessionIterator = sessions_.find(sessionToken);
-
-        if (sessionIterator != sessions_.end())
         {
+            QMutexLocker locker(&lock_);
+
+            auto sessionIterator = sessions_.find(sessionToken);
+
+            if (sessionIterator == sessions_.end())
+            {
+                throw CoreException("Unable to find session to remove - token was not found: " + sessionToken);
+            }
+
+            session = std::move(sessionIterator->second);
             sessions_.erase(sessionIterator);
-            return { { "result", "ok" } };
         }
 
-        throw CoreException("Unable to find session to remove - token was not found: " + sessionToken);
+        // Stopping the session thread and dumping its data run outside the registry lock, when the
+        // requests still working on the session drop it
+        session.reset();
+
+        return { { "result", "ok" } };
     }
 
-    QJsonObject GetSessionInfo(const QString sessionToken)
+    QByteArray GetSessionInfo(const QString sessionToken)
     {
-        QMutexLocker locker(&lock_);
+        auto session = FindSession(sessionToken);
 
-        auto sessionIterator = sessions_.find(sessionToken);
-
-        if (sessionIterator != sessions_.end())
+        if (session != nullptr)
         {
-            return sessionIterator->second->GetInformation();
+            return session->GetInformation();
         }
 
         throw CoreException(QString("Unable to retrieve session information - token was not found: " + sessionToken));
@@ -85,16 +163,230 @@ public:
 
     QJsonObject AppendSessionSamples(const QString sessionToken, const QByteArray& samples)
     {
+        auto session = FindSession(sessionToken);
+
+        if (session != nullptr)
+        {
+            return session->PushSamples(samples);
+        }
+
+        throw CoreException("Unable to push samples to the session - token was not found: " + sessionToken);
+    }
+
+    QJsonObject ExportSession(const QString sessionToken)
+    {
+        auto session = FindSession(sessionToken);
+
+        if (session != nullptr)
+        {
+            auto snapshotData = session->ExportSnapshot().Serialize();
+            return { { "snapshot", QString::fromLatin1(snapshotData.toBase64()) }, { "result", "ok" } };
+        }
+
+        throw CoreException("Unable to export the session - token was not found: " + sessionToken);
+    }
+
+    // Pushes samples to and polls many sessions, resolved under one registry lock. Every item is
+    // { "token", optional base64 "samples", optional "sinceVersion" } and gets its own result,
+    // a failing item does not fail the batch. With sinceVersion, isChanged tells whether the result is newer,
+    // unchanged results are not repeated.
+    // Returns compact JSON, the items carry the serialized session information without re-parsing it
+    QByteArray ProcessBatch(const QJsonArray& items)
+    {
+        if (items.size() > SESSION_BATCH_MAX_ITEMS)
+        {
+            throw CoreException(QString("Invalid batch - more than %1 sessions").arg(SESSION_BATCH_MAX_ITEMS));
+        }
+
+        // Only resolving the sessions takes the registry lock, pushing and rendering run outside it
+        std::vector<std::shared_ptr<SessionModel>> itemSessions;
+        itemSessions.reserve(items.size());
+
+        {
+            QMutexLocker locker(&lock_);
+
+            for (const auto& itemValue : items)
+            {
+                auto sessionIterator = sessions_.find(itemValue.toObject()["token"].toString());
+                itemSessions.push_back(sessionIterator != sessions_.end() ? sessionIterator->second : nullptr);
+            }
+        }
+
+        QByteArray results("{\"sessions\":[");
+
+        for (int itemIndex = 0; itemIndex < items.size(); itemIndex++)
+        {
+            auto item = items[itemIndex].toObject();
+            auto sessionToken = item["token"].toString();
+            auto& session = itemSessions[itemIndex];
+
+            if (itemIndex > 0)
+            {
+                results.append(',');
+            }
+
+            try
+            {
+                if (session == nullptr)
+                {
+                    throw CoreException("Session token was not found: " + sessionToken);
+                }
+
+                QJsonObject itemFields;
+
+                if (item.contains("samples"))
+                {
+                    itemFields = session->PushSamples(QByteArray::fromBase64(item["samples"].toString().toLatin1()));
+                    itemFields.remove("result");
+                }
+
+                itemFields["token"] = sessionToken;
+
+                auto sinceVersion = item.contains("sinceVersion") ? item["sinceVersion"].toInt() : -1;
+                results.append(session->GetInformation(sinceVersion, itemFields));
+            }
+            catch (CoreException& ex)
+            {
+                QJsonObject itemError = { { "result", "error" }, { "message", ex.what() }, { "token", sessionToken } };
+                results.append(QJsonDocument(itemError).toJson(QJsonDocument::Compact));
+            }
+        }
+
+        results.append("],\"result\":\"ok\"}");
+
+        return results;
+    }
+
+    // Accepts the raw snapshot or the JSON object returned by ExportSession. A client identity from the
+    // gateway header replaces the one stored in the snapshot.
+    QJsonObject ImportSession(const QString sessionToken, const QByteArray& snapshotBody, const QString& clientId = QString())
+    {
+        if (QUuid(sessionToken).isNull())
+        {
+            throw CoreException("Unable to import the session - invalid token: " + sessionToken);
+        }
+
+        auto snapshotData = snapshotBody;
+
+        auto snapshotJson = QJsonDocument::fromJson(snapshotBody);
+        if (snapshotJson.isObject())
+        {
+            snapshotData = QByteArray::fromBase64(snapshotJson.object()["snapshot"].toString().toLatin1());
+        }
+
+        auto snapshot = SessionSnapshot::Deserialize(snapshotData);
+        snapshot.Validate(MusicSettings(), coreInstance_.GetMaxTrackCount());
+
+        if (clientId.isEmpty() == false)
+        {
+            snapshot.SessionInfo["clientId"] = clientId;
+        }
+
+        {
+            QMutexLocker locker(&lock_);
+
+            if (isDraining_)
+            {
+                throw CoreException("Unable to import the session - the node is draining");
+            }
+
+            if (sessions_.find(sessionToken) != sessions_.end())
+            {
+                throw CoreException("Unable to import the session - token is already in use: " + sessionToken);
+            }
+        }
+
+        // The session is configured and filled outside the registry lock, then published if the token is still free
+        auto session = sessionPool_.Acquire(snapshot.SessionInfo);
+        session->ImportSnapshot(snapshot);
+
+        {
+            QMutexLocker locker(&lock_);
+
+            if (sessions_.find(sessionToken) == sessions_.end())
+            {
+                sessions_[sessionToken] = Share(std::move(session));
+                return { { "token", sessionToken }, { "result", "ok" } };
+            }
+        }
+
+        sessionPool_.Release(std::move(session));
+        throw CoreException("Unable to import the session - token is already in use: " + sessionToken);
+    }
+
+    // Names a session in admin output without revealing its token, which is the only credential of the session
+    static QString SessionId(const QString& sessionToken)
+    {
+        auto digest = QCryptographicHash::hash(sessionToken.toUtf8(), QCryptographicHash::Sha256);
+        return QString::fromLatin1(digest.toHex().left(SESSION_ID_HEX_DIGITS));
+    }
+
+    // The sessions using most of a SessionUsage measure, each with its full usage and SessionId
+    QJsonObject TopSessions(const QString& measure, int count = SESSION_TOP_DEFAULT_COUNT)
+    {
+        if (SessionUsage::Measures().contains(measure) == false)
+        {
+            throw CoreException(QString("Unknown session measure: %1. Valid values are: %2").arg(measure).arg(SessionUsage::Measures().join(", ")));
+        }
+
+        if (count <= 0)
+        {
+            throw CoreException("Invalid sessions count - must be a positive integer");
+        }
+
+        std::vector<std::pair<uint64_t, const QString*>> ranking;
+
         QMutexLocker locker(&lock_);
 
-        auto sessionIterator = sessions_.find(sessionToken);
+        ranking.reserve(sessions_.size());
+        for (const auto& session : sessions_)
+        {
+            ranking.emplace_back(session.second->Usage().Measure(measure), &session.first);
+        }
+
+        auto rankedCount = std::min(ranking.size(), static_cast<size_t>(count));
+        std::partial_sort(ranking.begin(), ranking.begin() + rankedCount, ranking.end(), [](const auto& left, const auto& right) {
+            return left.first > right.first;
+        });
 
-        if (sessionIterator != sessions_.end())
+        QJsonArray topSessions;
+        for (size_t n = 0; n < rankedCount; n++)
         {
-            return sessionIterator->second->PushSamples(samples);
+            auto usage = sessions_[*ranking[n].second]->Usage().ToJson();
+            usage["session"] = SessionId(*ranking[n].second);
+            topSessions.append(usage);
         }
 
-        throw CoreException("Unable to push samples to the session - token was not found: " + sessionToken);
+        return { { "measure", measure },
+                 { "sessionsCount", static_cast<int>(sessions_.size()) },
+                 { "sessions", topSessions },
+                 { "result", "ok" } };
+    }
+
+    void StartDrain()
+    {
+        QMutexLocker locker(&lock_);
+        isDraining_ = true;
+    }
+
+    bool IsDraining()
+    {
+        QMutexLocker locker(&lock_);
+        return isDraining_;
+    }
+
+    // Sessions whose threads still run - idle sessions finish after SESSION_TIMEOUT_SECONDS
+    size_t ActiveSessionsCount()
+    {
+        QMutexLocker locker(&lock_);
+
+        return std::count_if(sessions_.begin(), sessions_.end(), [](const auto& session) { return session.second->isRunning(); });
+    }
+
+    size_t SessionsCount()
+    {
+        QMutexLocker locker(&lock_);
+        return sessions_.size();
     }
 };
 
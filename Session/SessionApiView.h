@@ -28,31 +28,53 @@ private:
     SessionApiModel sessionModel_;
 
 public:
-    SessionApiView(ICoreInstance& coreInstance)
-        : sessionModel_(coreInstance)
+    SessionApiView(ICoreInstance& coreInstance, const ShardSettings& shardSettings)
+        : sessionModel_(coreInstance, shardSettings)
     {
     }
 
+    SessionApiModel& Model() { return sessionModel_; }
+
     QString Name() override { return "SessionApiView"; }
-    QStringList Endpoints() override { return { "session", "session/<arg>" }; }
+    QStringList Endpoints() override { return { "session", "session/<arg>", "session/<arg>/<arg>" }; }
 
     QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::All; }
 
-    QJsonObject Get(const QHttpServerRequest&, const QStringList& arguments) override
+    // Session information is polled often, it is answered with the JSON the session keeps serialized
+    QByteArray Serialized(const QHttpServerRequest& request, const RouteArguments& arguments) override
     {
-        if (arguments.size() == 1)
+        if (request.method() == QHttpServerRequest::Method::Get && arguments.size() == 1)
         {
             return sessionModel_.GetSessionInfo(arguments[0]);
         }
 
+        return QByteArray();
+    }
+
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments& arguments) override
+    {
+        if (arguments.size() == 2 && arguments[1] == "snapshot")
+        {
+            return sessionModel_.ExportSession(arguments[0]);
+        }
+
         throw CoreException("Invalid GET request - malformed query path");
     }
 
-    QJsonObject Post(const QHttpServerRequest& request, const QStringList& arguments) override
+    QJsonObject Post(const QHttpServerRequest& request, const RouteArguments& arguments) override
     {
         if (arguments.size() == 0)
         {
-            return sessionModel_.CreateSession(QJsonDocument::fromJson(request.body()).object());
+            auto sessionInfo = QJsonDocument::fromJson(request.body()).object();
+
+            // The header is set by the trusted gateway in front of the node and overrides what the caller claims
+            auto clientId = request.value(CLIENT_ID_HEADER);
+            if (clientId.isEmpty() == false)
+            {
+                sessionInfo["clientId"] = QString::fromUtf8(clientId);
+            }
+
+            return sessionModel_.CreateSession(sessionInfo);
         } else if (arguments.size() == 1)
         {
             return sessionModel_.AppendSessionSamples(arguments[0], request.body());
@@ -61,17 +83,21 @@ public:
         throw CoreException("Invalid POST request - malformed query path");
     }
 
-    QJsonObject Put(const QHttpServerRequest& request, const QStringList& arguments) override
+    QJsonObject Put(const QHttpServerRequest& request, const RouteArguments& arguments) override
     {
         if (arguments.size() == 1)
         {
             return sessionModel_.AppendSessionSamples(arguments[0], request.body());
         }
+        else if (arguments.size() == 2 && arguments[1] == "snapshot")
+        {
+            return sessionModel_.ImportSession(arguments[0], request.body(), QString::fromUtf8(request.value(CLIENT_ID_HEADER)));
+        }
 
         throw CoreException("Invalid PUT request - malformed query path");
     }
 
-    QJsonObject Delete(const QHttpServerRequest&, const QStringList& arguments) override
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments& arguments) override
     {
         if (arguments.size() == 1)
         {
@@ -0,0 +1,64 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONBATCHAPIVIEW_H
+#define SESSIONBATCHAPIVIEW_H
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "CoreException.h"
+#include "API/IBaseApiView.h"
+#include "API/Session/SessionApiModel.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+// POST sessions - polls and feeds many sessions in one request, for gateways multiplexing end-user sessions
+class SessionBatchApiView : public IBaseApiView
+{
+private:
+    SessionApiModel& sessionModel_;
+
+public:
+    SessionBatchApiView(SessionApiModel& sessionModel)
+        : sessionModel_(sessionModel)
+    {
+    }
+
+    QString Name() override { return "SessionBatchApiView"; }
+    QStringList Endpoints() override { return { "sessions" }; }
+
+    QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::Post; }
+
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+
+    QByteArray Serialized(const QHttpServerRequest& request, const RouteArguments&) override
+    {
+        auto body = QJsonDocument::fromJson(request.body());
+
+        if (body.isObject() == false || body.object()["sessions"].isArray() == false)
+        {
+            throw CoreException("Invalid batch request - expected an object with a 'sessions' array");
+        }
+
+        return sessionModel_.ProcessBatch(body.object()["sessions"].toArray());
+    }
+
+    QJsonObject Post(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+
+    QJsonObject Put(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONBATCHAPIVIEW_H
@@ -12,11 +12,19 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
 #include <queue>
+#include <thread>
 #include <unordered_set>
 
 #include <QDate>
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
 #include <QJsonArray>
+#include <QJsonDocument>
 #include <QJsonObject>
 #include <QMutex>
 #include <QMutexLocker>
@@ -30,11 +38,33 @@
 #include "CoreInstance.h"
 #include "Engine/Fingerprinter.h"
 #include "Engine/SearchHashesWorker.h"
+#include "API/Dsp/Kernels.h"
+#include "API/Dsp/SignalGate.h"
+#include "API/Dsp/StreamResampler.h"
+#include "API/Health/AllocationCounter.h"
+#include "API/Search/CatalogueSearch.h"
+#include "API/Search/CatalogueSearchPool.h"
+#include "API/Search/NumaTopology.h"
+#include "API/Search/SearchScheduler.h"
+#include "API/Session/SessionServices.h"
+#include "API/Session/ClientRegistry.h"
+#include "API/Session/SampleChunkList.h"
+#include "API/Session/SessionSnapshot.h"
+#include "API/Session/SessionUsage.h"
+#include "API/Session/SharedSearchRegistry.h"
+#include "API/Session/TrackNameCache.h"
+#include "API/Shards/ShardClient.h"
+#include "API/Shards/ShardSettings.h"
 
 #define THREAD_TICK_MILLISECONDS 50
 #define MAX_TRACKS_IN_RESULT 20
 #define SESSION_TIMEOUT_SECONDS 30
-#define SEARCH_WORKERS_COUNT 80
+#define INTERACTIVE_LATENCY_BUDGET_MS 1000
+// Batch searches run without a deadline but queue for a search slot as if due this long after the push,
+// so a steady stream of interactive searches cannot postpone them forever
+#define BATCH_SCHEDULING_DEADLINE_MS 30000
+// Runs of equal catches up to this many ranks are summed directly by EstimateApprox
+#define ESTIMATE_DIRECT_SUM_RANKS 16
 
 namespace dePhonica::Core::Api {
 
@@ -50,11 +80,51 @@ private:
     QMutex lock_, conditionLock_;
 
     const ICoreInstance& coreInstance_;
-    const QJsonObject sessionInfo_;
+    SearchScheduler& searchScheduler_;
+    CatalogueSearchPool& catalogueSearches_;
+    const NumaTopology& topology_;
 
-    SingleBuffer<PCMTYPE> collectBuffer_;
+    // The session thread runs on this node and searches with workers of the same node
+    size_t numaNode_;
+
+    SharedSearchRegistry& sharedSearches_;
+    const ShardSettings& shardSettings_;
+    SessionRecorder& recorder_;
+    ClientRegistry& clients_;
+
+    // Account of the client owning the session, set while the session is configured
+    ClientAccount* client_ = nullptr;
+    size_t searchesThrottled_ = 0;
+    QJsonObject sessionInfo_;
+    bool isConfigured_ = false;
+
+    struct SearchRequest
+    {
+        uint32_t LengthSamples = 0;
+        QDeadlineTimer Deadline;
+        // Orders the request in the search scheduler
+        QDeadlineTimer SchedulingDeadline;
+    };
+
+    // Resampled session audio, appended by PushSamples and read by searches without copying
+    SampleChunkList collectedSamples_;
     QWaitCondition isCollectBufferUpdated_;
-    std::queue<uint32_t> requestLengthQueue_;
+    std::queue<SearchRequest> requestLengthQueue_;
+
+    // Zero budget means the search has no deadline. A search admitted after its deadline is dropped when a newer one is queued
+    qint64 latencyBudgetMilliseconds_;
+
+    StreamResampler resampler_;
+    // Converted input of the last push, kept to reuse its storage - pushes are serialized by SessionApiModel
+    std::vector<PCMTYPE> pushedSamples_;
+    SignalGate signalGate_;
+    size_t searchesSkipped_ = 0, peaksExcluded_ = 0;
+
+    bool isSharedSearchEnabled_;
+    // Identity of this configuration of the session in the shared search registry
+    uint64_t sharedSearchKey_ = 0;
+    size_t searchesShared_ = 0;
+    double averageSearchMilliseconds_ = 0;
 
     enum class SampleTypes
     {
@@ -65,105 +135,406 @@ private:
 
     SampleTypes sampleType_;
 
+    // Temporaries of a search, used by the session thread only and kept between searches,
+    // so the steady-state search loop reuses their storage instead of allocating
+    struct SearchScratch
+    {
+        SampleView Samples;
+        SingleBuffer<PCMTYPE> ProcessingBuffer { "Processing buffer" };
+        // Peak votes, chunk-major - the bands of one chunk are adjacent
+        std::vector<uint8_t> Votes;
+        std::vector<uint32_t> VotedBands;
+        std::vector<uint8_t> IsChunkSilent;
+        std::vector<PeakDescription> FragmentPeaks;
+        std::vector<LutResult> SearchResult;
+        CatchHistogram Catches;
+    };
+
+    SearchScratch scratch_;
+
+    SessionUsage usage_;
+
+    // Operator new calls of the session thread during the last search, counted with DEPHONICA_COUNT_ALLOCATIONS only.
+    // Not zero in steady state: the session log, the shared search sketch and alignment, the shard requests
+    // and the engine's GroupPeaks and fingerprinter still allocate on every search.
+    uint64_t lastSearchAllocations_ = 0;
+
+    std::vector<PeakDescription> fragmentPeaks_;
     std::vector<LutResult> searchResult_;
     size_t resultVersionIndex_;
     float maxResultDelta_ = 0, sqAverageDelta_ = 0;
+    bool isPartialResult_ = false;
+
+    // Serialized result part of GetInformation, with and without the tracks, valid while
+    // renderedVersionIndex_ matches resultVersionIndex_
+    QByteArray renderedResult_, renderedSummary_;
+    size_t renderedVersionIndex_ = std::numeric_limits<size_t>::max();
+    TrackNameCache& trackNames_;
 
     QString sessionLog_;
 
     MusicSettings musicSettings_;
 
+    // Set for the sessions sampled for recording, written by the recorder while the session runs
+    std::shared_ptr<SessionRecording> recording_;
+
+    // Built once per session object and kept while it sits in the session pool
+    std::unique_ptr<Fingerprinter> fingerprinter_;
+
 public:
-    SessionModel(const ICoreInstance& coreInstance, const QJsonObject& sessionInfo)
+    // Creates an idle session, Configure turns it into a running one
+    SessionModel(const SessionServices& services)
         : lock_(QMutex::Recursive)
-        , coreInstance_(coreInstance)
-        , sessionInfo_(sessionInfo)
-        , collectBuffer_("SessionModel collection buffer", 16000 * 60)
+        , coreInstance_(services.CoreInstance)
+        , searchScheduler_(services.Scheduler)
+        , catalogueSearches_(services.CatalogueSearches)
+        , topology_(services.Topology)
+        , numaNode_(services.Topology.NextNode())
+        , sharedSearches_(services.SharedSearches)
+        , shardSettings_(services.Shards)
+        , recorder_(services.Recorder)
+        , clients_(services.Clients)
+        , latencyBudgetMilliseconds_(0)
+        , isSharedSearchEnabled_(false)
         , sampleType_(SampleTypes::none)
         , resultVersionIndex_(0)
+        , trackNames_(services.TrackNames)
+    {
+    }
+
+    SessionModel(const SessionServices& services, const QJsonObject& sessionInfo)
+        : SessionModel(services)
+    {
+        Configure(sessionInfo);
+    }
+
+    ~SessionModel()
+    {
+        requestInterruption();
+        wait();
+
+        DumpSessionData();
+        ReleaseClient();
+    }
+
+    // Allocates what the first search needs, so a pooled session starts searching at once
+    void Prepare()
+    {
+        collectedSamples_.Reserve();
+
+        if (fingerprinter_ == nullptr)
+        {
+            fingerprinter_ = std::make_unique<Fingerprinter>(musicSettings_);
+        }
+    }
+
+    // Prepare run by a thread pinned to the node of the session, so the buffers are first touched there
+    void PrepareOnNode()
+    {
+        std::exception_ptr exception;
+
+        std::thread([&]() {
+            topology_.PinCurrentThread(numaNode_);
+
+            try
+            {
+                Prepare();
+            }
+            catch (...)
+            {
+                exception = std::current_exception();
+            }
+        }).join();
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // Validates the session definition and starts the session, an invalid definition leaves the session idle
+    void Configure(const QJsonObject& sessionInfo)
     {
         if (sessionInfo.contains("sampleType") == false)
         {
             throw CoreException("Undefined 'sampleType' property in the session definition. Valid values are: 'f32le', 's16le'");
         }
 
-        auto sampleType = sessionInfo["sampleType"].toString();
-        if (sampleType == "f32le")
+        auto sampleType = SampleTypes::none;
+        auto sampleTypeName = sessionInfo["sampleType"].toString();
+        if (sampleTypeName == "f32le")
+        {
+            sampleType = SampleTypes::f32le;
+        }
+        else if (sampleTypeName == "s16le")
         {
-            sampleType_ = SampleTypes::f32le;
+            sampleType = SampleTypes::s16le;
         }
-        else if (sampleType == "s16le")
+
+        qint64 latencyBudgetMilliseconds = 0;
+
+        auto priority = sessionInfo["priority"].toString("batch");
+        if (priority == "interactive")
+        {
+            latencyBudgetMilliseconds = INTERACTIVE_LATENCY_BUDGET_MS;
+        }
+        else if (priority != "batch")
+        {
+            throw CoreException("Invalid 'priority' property in the session definition. Valid values are: 'interactive', 'batch'");
+        }
+
+        if (sessionInfo.contains("latencyBudgetMs"))
+        {
+            latencyBudgetMilliseconds = sessionInfo["latencyBudgetMs"].toInt(-1);
+
+            if (latencyBudgetMilliseconds < 0)
+            {
+                throw CoreException("Invalid 'latencyBudgetMs' property in the session definition - must be a non-negative integer");
+            }
+        }
+
+        auto inputSampleRate = sessionInfo["sampleRate"].toInt(musicSettings_.TargetSampleRate);
+        if (inputSampleRate <= 0 || StreamResampler::IsSupportedRate(static_cast<size_t>(inputSampleRate)) == false)
+        {
+            throw CoreException(QString("Invalid 'sampleRate' property in the session definition - must be one of 8000, 11025, 12000, "
+                                        "16000, 22050, 24000, 32000, 44100, 48000, 88200, 96000, 176400, 192000 Hz"));
+        }
+
+        auto inputChannels = sessionInfo["channels"].toInt(1);
+        if (inputChannels < 1 || inputChannels > RESAMPLER_MAX_CHANNELS)
         {
-            sampleType_ = SampleTypes::s16le;
+            throw CoreException(
+                QString("Invalid 'channels' property in the session definition - must be between 1 and %1").arg(RESAMPLER_MAX_CHANNELS));
         }
 
+        auto clientId = sessionInfo["clientId"].toString();
+        client_ = &clients_.Acquire(clientId.isEmpty() ? CLIENT_DEFAULT_ID : clientId);
+
+        sessionInfo_ = sessionInfo;
+        sampleType_ = sampleType;
+        latencyBudgetMilliseconds_ = latencyBudgetMilliseconds;
+        isSharedSearchEnabled_ = sessionInfo["sharedSearch"].toBool(false);
+        sharedSearchKey_ = sharedSearches_.NewSessionKey();
+
+        resampler_.Configure(inputSampleRate, musicSettings_.TargetSampleRate, inputChannels);
+
+        if (resampler_.Filter() != nullptr && resampler_.Filter()->MeetsStopband() == false)
+        {
+            qWarning() << QString("Resampling from %1 Hz reaches %2 dB stopband attenuation only, %3 dB were specified")
+                              .arg(inputSampleRate)
+                              .arg(resampler_.Filter()->StopbandDb, 0, 'f', 1)
+                              .arg(RESAMPLER_STOPBAND_DB);
+        }
+
+        signalGate_.Configure(static_cast<float>(sessionInfo["silenceThresholdDb"].toDouble(SIGNAL_GATE_SILENCE_DB)),
+                              static_cast<float>(sessionInfo["flatnessThreshold"].toDouble(SIGNAL_GATE_FLATNESS)));
+
+        recording_ = recorder_.Open(sessionInfo, musicSettings_.TargetSampleRate);
+        isConfigured_ = true;
+
         start();
     }
 
-    ~SessionModel()
+    // Stops the session and returns it to the idle state, keeping its allocations for the next Configure
+    void Reset()
     {
-        coreInstance_.DumpSessionData(collectBuffer_, sessionLog_, sessionInfo_.contains("storeSessionData"));
-
         requestInterruption();
         wait();
+
+        DumpSessionData();
+        ReleaseClient();
+
+        QMutexLocker locker(&lock_);
+
+        collectedSamples_.Reset();
+        requestLengthQueue_ = std::queue<SearchRequest>();
+
+        resampler_.Reset();
+        signalGate_.Reset();
+        searchesSkipped_ = 0;
+        peaksExcluded_ = 0;
+        searchesShared_ = 0;
+        averageSearchMilliseconds_ = 0;
+        lastSearchAllocations_ = 0;
+        usage_.Reset();
+        searchesThrottled_ = 0;
+
+        fragmentPeaks_.clear();
+        searchResult_.clear();
+        resultVersionIndex_ = 0;
+        maxResultDelta_ = 0;
+        sqAverageDelta_ = 0;
+        isPartialResult_ = false;
+
+        renderedResult_.clear();
+        renderedSummary_.clear();
+        renderedVersionIndex_ = std::numeric_limits<size_t>::max();
+
+        sessionLog_.clear();
+        lastLogTimestamp_ = QDateTime();
+        sessionInfo_ = QJsonObject();
+        sampleType_ = SampleTypes::none;
+        isConfigured_ = false;
     }
 
-    QJsonObject GetInformation()
+    // Readable without the session lock
+    const SessionUsage& Usage() const { return usage_; }
+
+    // Session information as compact JSON. The result part is serialized once per result version, only the
+    // small per-call fields are rendered and appended to it. With sinceVersion, a result not newer than it
+    // leaves the tracks out and isChanged tells which. The given fields go into the per-call part.
+    QByteArray GetInformation(qint64 sinceVersion = -1, QJsonObject fields = QJsonObject())
     {
+        // Copies the state under the lock, the JSON is rendered and track names are resolved outside it
         lock_.lock();
-        std::vector<LutResult> searchResult(searchResult_);
-        size_t resultVersionIndex = resultVersionIndex_;
+
+        auto resultVersion = resultVersionIndex_;
+        bool isRendered = renderedVersionIndex_ == resultVersionIndex_;
+
+        QByteArray renderedResult, renderedSummary;
+        std::vector<LutResult> searchResult;
+        float maxResultDelta = maxResultDelta_, sqAverageDelta = sqAverageDelta_;
+        bool isPartialResult = isPartialResult_;
+
+        if (isRendered)
+        {
+            renderedResult = renderedResult_;
+            renderedSummary = renderedSummary_;
+        }
+        else
+        {
+            searchResult = searchResult_;
+        }
+
+        auto silentSamples = signalGate_.SilentSamples();
+        auto searchesSkipped = searchesSkipped_, peaksExcluded = peaksExcluded_, searchesShared = searchesShared_;
+        auto estimatedCpuSavedMilliseconds = searchesSkipped_ * averageSearchMilliseconds_;
+        auto searchesThrottled = searchesThrottled_;
+        auto lastSearchAllocations = lastSearchAllocations_;
+
         lock_.unlock();
 
-        QJsonArray tracksObject;
-        for (auto& result : searchResult)
+        if (isRendered == false)
         {
-            tracksObject.append(QJsonObject(
-                { { "fileIndex", static_cast<int>(result.TrackIndex) },
-                  { "fileName", coreInstance_.GetFileNameByIndex(result.TrackIndex) },
-                  { "filePositionSeconds",
-                    static_cast<double>(result.ChunkIndex * (musicSettings_.SliceDurationSeconds - musicSettings_.SliceOverlapSeconds)) },
-                  { "similarity", static_cast<int>(result.Catches) } }));
+            QJsonArray tracksObject;
+            for (auto& result : searchResult)
+            {
+                tracksObject.append(QJsonObject(
+                    { { "fileIndex", static_cast<int>(result.TrackIndex) },
+                      { "fileName", trackNames_.GetFileName(result.TrackIndex) },
+                      { "filePositionSeconds",
+                        static_cast<double>(result.ChunkIndex * (musicSettings_.SliceDurationSeconds - musicSettings_.SliceOverlapSeconds)) },
+                      { "similarity", static_cast<int>(result.Catches) } }));
+            }
+
+            QJsonObject summary = { { "resultVersion", static_cast<int>(resultVersion) },
+                                    { "maxResultDelta", maxResultDelta },
+                                    { "squareAverageDelta", sqAverageDelta },
+                                    { "isPartialResult", isPartialResult },
+                                    { "result", "ok" } };
+            renderedSummary = QJsonDocument(summary).toJson(QJsonDocument::Compact);
+
+            summary["resultTracks"] = tracksObject;
+            renderedResult = QJsonDocument(summary).toJson(QJsonDocument::Compact);
+
+            // A newer result may have been assigned meanwhile, it gets rendered by the next call
+            QMutexLocker locker(&lock_);
+            if (resultVersionIndex_ == resultVersion)
+            {
+                renderedResult_ = renderedResult;
+                renderedSummary_ = renderedSummary;
+                renderedVersionIndex_ = resultVersion;
+            }
         }
 
-        return { { "resultVersion", static_cast<int>(resultVersionIndex) },
-                 { "resultTracks", tracksObject },
-                 { "maxResultDelta", maxResultDelta_ },
-                 { "squareAverageDelta", sqAverageDelta_ },
-                 { "result", "ok" } };
+        bool isChanged = static_cast<qint64>(resultVersion) > sinceVersion;
+
+        if (sinceVersion >= 0)
+        {
+            fields["isChanged"] = isChanged;
+        }
+
+        fields["signalGate"] = QJsonObject(
+            { { "silentSeconds", static_cast<double>(silentSamples) / musicSettings_.TargetSampleRate },
+              { "searchesSkipped", static_cast<int>(searchesSkipped) },
+              { "peaksExcluded", static_cast<int>(peaksExcluded) },
+              { "estimatedCpuSavedMs", estimatedCpuSavedMilliseconds } });
+        fields["sharedSearch"] = QJsonObject({ { "enabled", isSharedSearchEnabled_ }, { "searchesShared", static_cast<int>(searchesShared) } });
+        fields["client"] = QJsonObject(
+            { { "clientId", client_ != nullptr ? client_->Id() : QString() }, { "searchesThrottled", static_cast<int>(searchesThrottled) } });
+
+        if (AllocationCounter::IsEnabled())
+        {
+            fields["allocationsPerSearch"] = static_cast<qint64>(lastSearchAllocations);
+        }
+
+        // Both parts are non-empty compact objects with distinct keys, joined by dropping the brace between them
+        const auto& rendered = isChanged ? renderedResult : renderedSummary;
+        auto fieldsJson = QJsonDocument(fields).toJson(QJsonDocument::Compact);
+
+        QByteArray information;
+        information.reserve(rendered.size() + fieldsJson.size());
+        information.append(rendered.constData(), rendered.size() - 1);
+        information.append(',');
+        information.append(fieldsJson.constData() + 1, fieldsJson.size() - 1);
+
+        return information;
     }
 
     QJsonObject PushSamples(const QByteArray& samples)
     {
-        std::vector<PCMTYPE> samplesVector;
+        auto& samplesVector = pushedSamples_;
 
         if (sampleType_ == SampleTypes::f32le)
         {
             auto samplesCount = samples.size() / sizeof(float);
             auto samplesFloat = reinterpret_cast<const float*>(samples.data());
-            std::copy(samplesFloat, samplesFloat + samplesCount, std::back_inserter(samplesVector));
+            samplesVector.assign(samplesFloat, samplesFloat + samplesCount);
         }
         else if (sampleType_ == SampleTypes::s16le)
         {
-            auto samplesCount = samples.size() / sizeof(short);
-            auto samplesShort = reinterpret_cast<const short*>(samples.data());
-
-            for (size_t n = 0; n < samplesCount; n++)
-            {
-                samplesVector.push_back(static_cast<float>(samplesShort[n]) / 32768.0f);
-            }
+            auto samplesCount = samples.size() / sizeof(int16_t);
+            samplesVector.resize(samplesCount);
+            Kernels::ConvertS16(reinterpret_cast<const int16_t*>(samples.data()), samplesCount, samplesVector.data());
         }
         else
         {
             throw CoreException("Unable to push samples into the session with an invalid session info");
         }
 
-        collectBuffer_.Ensure(collectBuffer_.DataLengthSamples() + samplesVector.size());
-        std::copy(samplesVector.begin(), samplesVector.end(), collectBuffer_.BufferData().begin() + collectBuffer_.DataLengthSamples());
-        collectBuffer_.DataLengthSamples(collectBuffer_.DataLengthSamples() + samplesVector.size());
+        if (samplesVector.size() % resampler_.ChannelsCount() != 0)
+        {
+            throw CoreException("Unable to push samples into the session - samples count is not a multiple of the channels count");
+        }
+
+        // Only valid pushes take a token, the client is charged the raw bytes of the request body
+        auto pushedBytes = static_cast<size_t>(samples.size());
+        if (client_ != nullptr && client_->TryPush(pushedBytes) == false)
+        {
+            throw CoreException("Unable to push samples into the session - push rate limit of the client exceeded: " + client_->Id());
+        }
+
+        // Downmix and resample straight into the collected samples, the resampler keeps its state between pushes
+        auto framesCount = samplesVector.size() / resampler_.ChannelsCount();
+
+        auto collectStorage = collectedSamples_.PrepareAppend(resampler_.MaxOutputSamples(framesCount));
+        auto samplesCollected = resampler_.Process(samplesVector.data(), framesCount, collectStorage);
+        auto collectedSamples = collectedSamples_.CommitAppend(samplesCollected);
+
+        SessionUsage::Set(usage_.BufferBytes, collectedSamples_.AllocatedBytes());
+
+        lock_.lock();
+        signalGate_.Push(collectedSamples, samplesCollected);
+        Record(collectedSamples, samplesCollected);
+        lock_.unlock();
+
+        auto deadline = latencyBudgetMilliseconds_ > 0 ? QDeadlineTimer(latencyBudgetMilliseconds_)
+                                                       : QDeadlineTimer(QDeadlineTimer::Forever);
+        auto schedulingDeadline = latencyBudgetMilliseconds_ > 0 ? deadline : QDeadlineTimer(BATCH_SCHEDULING_DEADLINE_MS);
 
         lock_.lock();
-        requestLengthQueue_.push(collectBuffer_.DataLengthSamples());
+        requestLengthQueue_.push({ static_cast<uint32_t>(collectedSamples_.Length()), deadline, schedulingDeadline });
+        SessionUsage::Set(usage_.QueuedRequests, requestLengthQueue_.size());
         lock_.unlock();
 
         conditionLock_.lock();
@@ -171,22 +542,77 @@ public:
         conditionLock_.unlock();
 
         return { { "samplesPushed", static_cast<int>(samplesVector.size()) },
-                 { "samplesCollected", static_cast<int>(collectBuffer_.DataLengthSamples()) },
+                 { "samplesCollected", static_cast<int>(collectedSamples_.Length()) },
                  { "result", "ok" } };
     }
 
+    SessionSnapshot ExportSnapshot()
+    {
+        SessionSnapshot snapshot;
+        snapshot.SessionInfo = sessionInfo_;
+
+        SampleView samples;
+        collectedSamples_.View(samples);
+
+        // Only the most recent audio up to the snapshot limit moves, the importing node searches that window
+        auto exportedLength = std::min<size_t>(samples.Length(), SESSION_SNAPSHOT_MAX_SAMPLES);
+        snapshot.Samples.resize(exportedLength);
+        samples.CopyTo(snapshot.Samples.data(), samples.Length() - exportedLength, exportedLength);
+
+        QMutexLocker locker(&lock_);
+
+        snapshot.FragmentPeaks = fragmentPeaks_;
+        snapshot.SearchResult = searchResult_;
+        snapshot.ResultVersion = resultVersionIndex_;
+        snapshot.MaxResultDelta = maxResultDelta_;
+        snapshot.SqAverageDelta = sqAverageDelta_;
+        snapshot.IsPartialResult = isPartialResult_;
+
+        return snapshot;
+    }
+
+    // Restores the state of a session exported on another node, must precede any PushSamples
+    void ImportSnapshot(const SessionSnapshot& snapshot)
+    {
+        collectedSamples_.Append(snapshot.Samples.data(), snapshot.Samples.size());
+        SessionUsage::Set(usage_.BufferBytes, collectedSamples_.AllocatedBytes());
+
+        QMutexLocker locker(&lock_);
+
+        signalGate_.Reset();
+        signalGate_.Push(snapshot.Samples.data(), snapshot.Samples.size());
+        Record(snapshot.Samples.data(), snapshot.Samples.size());
+
+        fragmentPeaks_ = snapshot.FragmentPeaks;
+        searchResult_ = snapshot.SearchResult;
+        resultVersionIndex_ = snapshot.ResultVersion;
+        maxResultDelta_ = snapshot.MaxResultDelta;
+        sqAverageDelta_ = snapshot.SqAverageDelta;
+        isPartialResult_ = snapshot.IsPartialResult;
+    }
+
 protected:
     void run()
     {
         qInfo() << "Thread started with ID: " << QThread::currentThreadId();
 
-        Fingerprinter fingerprinter(musicSettings_);
+        topology_.PinCurrentThread(numaNode_);
+
+        Prepare();
+        auto& fingerprinter = *fingerprinter_;
 
         int timeoutCounter = 0;
+        size_t lastSearchedLength = 0;
         size_t maxTrackCount = coreInstance_.GetMaxTrackCount();
-        auto tracksCompareTo = std::make_unique<uint8_t[]>(maxTrackCount);
 
-        auto workers = SearchHashesWorker::AllocateWorkers(SEARCH_WORKERS_COUNT, coreInstance_);
+        // Distributed mode sends the peaks to the index shards instead of searching the local index,
+        // local searches borrow pooled workers for the time of one search
+        std::unique_ptr<ShardClient> shardClient;
+
+        if (shardSettings_.IsEnabled())
+        {
+            shardClient = std::make_unique<ShardClient>(shardSettings_);
+        }
 
         while (QThread::currentThread()->isInterruptionRequested() == false)
         {
@@ -207,9 +633,12 @@ protected:
 
             timeoutCounter = 0;
 
+            // The chunk the next pushes go to is allocated here, on the session node, rather than by the pushing thread
+            collectedSamples_.ReserveAhead(SAMPLE_CHUNK_SAMPLES / 2);
+
             while (true)
             {
-                uint32_t requestLength = 0;
+                SearchRequest request;
 
                 {
                     QMutexLocker locker(&lock_);
@@ -219,49 +648,147 @@ protected:
                         break;
                     }
 
-                    requestLength = requestLengthQueue_.front();
+                    request = requestLengthQueue_.front();
                     requestLengthQueue_.pop();
+                    SessionUsage::Set(usage_.QueuedRequests, requestLengthQueue_.size());
                 }
 
-                for (size_t n = 0; n < maxTrackCount; n++)
+                uint32_t requestLength = request.LengthSamples;
+
                 {
-                    tracksCompareTo[n] = 1;
+                    QMutexLocker locker(&lock_);
+
+                    if (signalGate_.HasSignal(lastSearchedLength, requestLength) == false)
+                    {
+                        searchesSkipped_++;
+                        continue;
+                    }
+                }
+
+                // A throttled search leaves its audio to the next search of the session
+                if (client_->TrySearch() == false)
+                {
+                    QMutexLocker locker(&lock_);
+                    searchesThrottled_++;
+                    continue;
                 }
 
+                auto previousSearchedLength = lastSearchedLength;
+                lastSearchedLength = requestLength;
+
+                QElapsedTimer searchTimer;
+                searchTimer.start();
+
+                auto allocationsBefore = AllocationCounter::ThreadAllocations();
+
                 try
                 {
-                    SingleBuffer<float> croppedBuffer("Session model crop buffer");
-                    croppedBuffer.Copy(collectBuffer_.BufferData().data(), requestLength, musicSettings_.TargetSampleRate);
-                    croppedBuffer.DataLengthSamples(requestLength);
+                    qint64 searchWaitMicroseconds = 0;
+
+                    // The view covers at least requestLength samples, they never change once appended
+                    collectedSamples_.View(scratch_.Samples);
 
                     Log(QString("1. Generating fingerprint for fragment %1 ms")
                             .arg(requestLength * 1000 / musicSettings_.TargetSampleRate));
 
-                    auto fragmentPeaks = GenerateFingerprint(fingerprinter, croppedBuffer);
+                    auto fingerprintCpuBefore = SessionUsage::ThreadCpuMicroseconds();
+                    const auto& fragmentPeaks = GenerateFingerprint(fingerprinter, scratch_.Samples, requestLength);
+                    SessionUsage::Add(usage_.FingerprintCpuMicroseconds, SessionUsage::ThreadCpuMicroseconds() - fingerprintCpuBefore);
 
-                    std::vector<LutResult> searchResult;
-                    searchResult.reserve(maxTrackCount);
+                    lock_.lock();
+                    fragmentPeaks_ = fragmentPeaks;
+                    lock_.unlock();
 
+                    auto& searchResult = scratch_.SearchResult;
                     float maxDelta = 1.0f;
                     float sqAverageDelta = 0;
+                    bool isPartialResult = false;
+                    bool isResultShared = false;
 
-                    auto tracksCompareToCount = maxTrackCount;
-
-                    searchResult.clear();
-
-                    Log(QString("3.2. Tracks to compare to: %1, peaks to compare: %2").arg(tracksCompareToCount).arg(fragmentPeaks.size()));
+                    // Sessions carrying the same stream share one catalogue search, the first one leads it
+                    std::shared_ptr<SharedSearch> sharedSearch;
+                    bool isSharedSearchLeader = false;
 
-                    auto fragmentPeaksGrouped = PeakCompareWorker::GroupPeaks(fragmentPeaks, 1);
+                    if (isSharedSearchEnabled_)
+                    {
+                        auto sketch = PeakSketch::FromPeaks(fragmentPeaks);
 
-                    SearchHashesWorker::ComparePeaks(workers, fragmentPeaksGrouped, tracksCompareTo, maxTrackCount);
-                    SearchHashesWorker::WaitAll(workers);
+                        if (sketch.IsEmpty() == false)
+                        {
+                            sharedSearch = sharedSearches_.Join(sketch, fragmentPeaks, sharedSearchKey_, isSharedSearchLeader);
+                        }
+                    }
 
-                    SearchHashesWorker::AggregateResultTracks(workers, searchResult, false);
+                    if (sharedSearch && isSharedSearchLeader == false)
+                    {
+                        auto waitMilliseconds = request.Deadline.isForever() ? SHARED_SEARCH_WAIT_MILLISECONDS
+                                                                             : std::max<qint64>(0, request.Deadline.remainingTime());
+
+                        if (sharedSearches_.Wait(sharedSearch, waitMilliseconds) &&
+                            SharedSearchRegistry::Rebase(*sharedSearch, fragmentPeaks, searchResult))
+                        {
+                            Log("3.1. Using the result of a matching stream search.");
+
+                            maxDelta = sharedSearch->MaxResultDelta;
+                            sqAverageDelta = sharedSearch->SqAverageDelta;
+                            isPartialResult = sharedSearch->IsPartialResult;
+                            isResultShared = true;
+                        }
+                    }
 
-                    Log("4. Calculate approximation.");
-                    maxDelta = EstimateApprox(searchResult, sqAverageDelta);
+                    if (isResultShared == false)
+                    {
+                        SharedSearchLeadership leadership(sharedSearches_, isSharedSearchLeader ? sharedSearch : nullptr);
+
+                        Log(QString("3.2. Tracks to compare to: %1, peaks to compare: %2").arg(maxTrackCount).arg(fragmentPeaks.size()));
+
+                        size_t partsSkipped = 0;
+
+                        {
+                            // Only the comparison with the catalogue holds a slot, fingerprinting runs on the session thread
+                            SearchSlot searchSlot(searchScheduler_, request.SchedulingDeadline, client_->Id(), client_->Weight());
+                            searchWaitMicroseconds = searchSlot.WaitMicroseconds();
+
+                            // A search which waited past its deadline while a newer request is queued would only
+                            // give a stale result, the newer search covers its audio
+                            if (request.Deadline.hasExpired() && IsRequestQueued())
+                            {
+                                Log("3.3. Deadline passed while waiting for a search slot, a newer search is queued.");
+                                lastSearchedLength = previousSearchedLength;
+                                continue;
+                            }
+
+                            QElapsedTimer compareTimer;
+                            compareTimer.start();
+
+                            if (shardClient)
+                            {
+                                partsSkipped = shardClient->Search(fragmentPeaks, request.Deadline, searchResult, &scratch_.Catches);
+                            }
+                            else
+                            {
+                                CatalogueSearchLease catalogueSearch(catalogueSearches_, numaNode_);
+                                catalogueSearch->Search(fragmentPeaks, searchResult, &scratch_.Catches);
+                            }
+
+                            SessionUsage::Add(usage_.CompareMicroseconds, compareTimer.nsecsElapsed() / 1000);
+                        }
+
+                        isPartialResult = partsSkipped > 0;
+                        if (isPartialResult)
+                        {
+                            Log(QString("3.3. Partial result, %1 shards did not answer").arg(partsSkipped));
+                        }
+
+                        Log("4. Calculate approximation.");
+                        // Local and sharded searches both count all matched tracks, so their statistics compare
+                        maxDelta = EstimateApprox(scratch_.Catches, sqAverageDelta);
+
+                        Log(QString("5. Max delta: %1").arg(maxDelta));
+
+                        leadership.Complete(searchResult, maxDelta, sqAverageDelta, isPartialResult);
+                    }
 
-                    Log(QString("5. Max delta: %1").arg(maxDelta));
                     Log("6. Assigning result...");
 
                     lock_.lock();
@@ -274,9 +801,20 @@ protected:
 
                     maxResultDelta_ = maxDelta;
                     sqAverageDelta_ = sqAverageDelta;
+                    isPartialResult_ = isPartialResult;
                     resultVersionIndex_++;
+                    searchesShared_ += isResultShared ? 1 : 0;
+
+                    averageSearchMilliseconds_ = averageSearchMilliseconds_ == 0
+                                                     ? searchTimer.elapsed()
+                                                     : averageSearchMilliseconds_ * 0.9 + searchTimer.elapsed() * 0.1;
+                    lastSearchAllocations_ = AllocationCounter::ThreadAllocations() - allocationsBefore;
                     lock_.unlock();
 
+                    SessionUsage::Add(usage_.SearchesRun, 1);
+                    SessionUsage::Set(usage_.LastSearchMicroseconds, searchTimer.nsecsElapsed() / 1000);
+                    client_->AddSearch(searchWaitMicroseconds, searchTimer.nsecsElapsed() / 1000);
+
                     Log("7. Done...");
                 }
                 catch (MusicException* ex)
@@ -286,7 +824,7 @@ protected:
 
                 if (searchResult_.size() > 0)
                 {
-                    Log("8. Top track: " + coreInstance_.GetFileNameByIndex(searchResult_[0].TrackIndex));
+                    Log("8. Top track: " + trackNames_.GetFileName(searchResult_[0].TrackIndex));
                 }
             }
         }
@@ -297,6 +835,12 @@ protected:
 private:
     QDateTime lastLogTimestamp_;
 
+    bool IsRequestQueued()
+    {
+        QMutexLocker locker(&lock_);
+        return requestLengthQueue_.empty() == false;
+    }
+
     void Log(QString message)
     {
         auto now = QDateTime::currentDateTime();
@@ -324,117 +868,295 @@ private:
         sessionLog_ += logLine + "\n";
     }
 
-    const std::vector<PeakDescription> GenerateFingerprint(Fingerprinter& fingerprinter, SingleBuffer<PCMTYPE>& inputBuffer)
+    void ReleaseClient()
     {
-        std::vector<uint8_t> peaksMapped[musicSettings_.FrequencyPoints];
+        if (client_ != nullptr)
+        {
+            clients_.Release(*client_);
+            client_ = nullptr;
+        }
+    }
 
-        size_t chunksCount = static_cast<size_t>(inputBuffer.DataLengthSeconds() / static_cast<double>(musicSettings_.SliceDurationSeconds -
-                                                                                                       musicSettings_.SliceOverlapSeconds));
-        for (size_t n = 0; n < musicSettings_.FrequencyPoints; n++)
+    // Called under the session lock
+    void Record(const float* samples, size_t count)
+    {
+        if (recording_)
         {
-            peaksMapped[n].resize(chunksCount);
+            recorder_.Append(recording_, samples, count);
         }
+    }
 
-        SingleBuffer<PCMTYPE> processingBuffer("Processing buffer", inputBuffer.DataLengthSamples() + 32);
+    void DumpSessionData()
+    {
+        if (isConfigured_ == false)
+        {
+            return;
+        }
+
+        bool isStoringData = sessionInfo_.contains("storeSessionData");
+        bool isRecorded = recording_ != nullptr;
+
+        if (isRecorded)
+        {
+            recorder_.Close(recording_, sessionLog_);
+            recording_.reset();
+        }
+
+        SingleBuffer<PCMTYPE> sessionData("SessionModel collection buffer");
+        sessionData.DataLengthSamples(0);
+
+        // The core reads the audio only to store it, and a recorded session has it on disk already, so the
+        // chunks are flattened into one buffer only when the session asks for its data to be stored
+        if (isStoringData && isRecorded == false)
+        {
+            SampleView samples;
+            collectedSamples_.View(samples);
+
+            sessionData.Ensure(samples.Length());
+            samples.CopyTo(sessionData.BufferData().data(), 0, samples.Length());
+            sessionData.DataLengthSamples(samples.Length());
+        }
+
+        coreInstance_.DumpSessionData(sessionData, sessionLog_, isStoringData);
+    }
+
+    // Returns the voted peaks ordered by chunk, then band, stored in the search scratch until the next search
+    const std::vector<PeakDescription>& GenerateFingerprint(Fingerprinter& fingerprinter, SampleView& samples, size_t samplesCount)
+    {
+        auto sampleRate = musicSettings_.TargetSampleRate;
+        auto dataLengthSeconds = static_cast<double>(samplesCount) / sampleRate;
+
+        size_t bandsCount = musicSettings_.FrequencyPoints;
+        size_t chunksCount =
+            static_cast<size_t>(dataLengthSeconds / static_cast<double>(musicSettings_.SliceDurationSeconds - musicSettings_.SliceOverlapSeconds));
+
+        auto& votes = scratch_.Votes;
+        votes.assign(chunksCount * bandsCount, 0);
+
+        auto& processingBuffer = scratch_.ProcessingBuffer;
+        processingBuffer.Ensure(samplesCount + 32);
 
         size_t stepsCounter = 0;
-        size_t initialOffset = inputBuffer.DataLengthSeconds() > 5 ? inputBuffer.SampleRate() : 0;
+        size_t initialOffset = dataLengthSeconds > 5 ? sampleRate : 0;
+        auto fragmentSamples = samples.Contiguous(initialOffset, samplesCount - initialOffset);
 
         for (size_t offset = 0; offset < 20000; offset += 757, stepsCounter++)
         {
-            processingBuffer.Copy(inputBuffer.BufferData().data() + offset + initialOffset,
-                                  inputBuffer.DataLengthSamples() - offset - initialOffset,
-                                  inputBuffer.SampleRate());
+            processingBuffer.Copy(fragmentSamples + offset, samplesCount - offset - initialOffset, sampleRate);
 
             fingerprinter.Generate(processingBuffer);
 
             auto fragmentPeaks = fingerprinter.PeaksCollection();
 
-            size_t chunkOffset = static_cast<double>(offset) / inputBuffer.SampleRate() /
+            size_t chunkOffset = static_cast<double>(offset) / sampleRate /
                                  static_cast<double>(musicSettings_.SliceDurationSeconds - musicSettings_.SliceOverlapSeconds);
 
             for (const auto& peak : fragmentPeaks)
             {
-                peaksMapped[peak.BandIndex][peak.ChunkIndex + chunkOffset]++;
+                size_t chunkIndex = peak.ChunkIndex + chunkOffset;
+
+                if (chunkIndex < chunksCount && static_cast<size_t>(peak.BandIndex) < bandsCount)
+                {
+                    votes[chunkIndex * bandsCount + peak.BandIndex]++;
+                }
             }
         }
 
         Log("2. Collecting fingerprint hashes.");
 
-        std::vector<PeakDescription> resultPeaks;
-
-        for (size_t n = 0; n < musicSettings_.FrequencyPoints; n++)
+        // Chunks lying completely in silent or noise-only spans give no usable peaks
+        auto& isChunkSilent = scratch_.IsChunkSilent;
+        isChunkSilent.assign(chunksCount, 0);
         {
-            const auto& bandVector = peaksMapped[n];
+            auto chunkStepSamples = static_cast<double>(musicSettings_.SliceDurationSeconds - musicSettings_.SliceOverlapSeconds) *
+                                    sampleRate;
+            auto chunkLengthSamples = static_cast<size_t>(musicSettings_.SliceDurationSeconds * sampleRate);
+
+            QMutexLocker locker(&lock_);
 
             for (size_t m = 0; m < chunksCount; m++)
             {
-                if (bandVector[m] > stepsCounter / 2)
-                {
-                    PeakDescription resultPeak;
-                    resultPeak.BandIndex = n;
-                    resultPeak.ChunkIndex = m;
-                    resultPeak.PeakCutoffDb = musicSettings_.PeakCutoffThresholdDb;
+                auto chunkBegin = initialOffset + static_cast<size_t>(m * chunkStepSamples);
+                isChunkSilent[m] = signalGate_.IsSilent(chunkBegin, chunkBegin + chunkLengthSamples) ? 1 : 0;
+            }
+        }
 
-                    resultPeaks.push_back(resultPeak);
-                }
+        auto& resultPeaks = scratch_.FragmentPeaks;
+        resultPeaks.clear();
+        size_t peaksExcluded = 0;
+
+        auto& votedBands = scratch_.VotedBands;
+        votedBands.resize(bandsCount);
+
+        // A peak is kept when more than half of the shifted fingerprints voted for it
+        auto votesThreshold = static_cast<uint8_t>(stepsCounter / 2);
+
+        for (size_t m = 0; m < chunksCount; m++)
+        {
+            auto votedCount = Kernels::IndicesAbove(votes.data() + m * bandsCount, bandsCount, votesThreshold, votedBands.data());
+
+            if (isChunkSilent[m])
+            {
+                peaksExcluded += votedCount;
+                continue;
+            }
+
+            for (size_t n = 0; n < votedCount; n++)
+            {
+                PeakDescription resultPeak;
+                resultPeak.BandIndex = votedBands[n];
+                resultPeak.ChunkIndex = m;
+                resultPeak.PeakCutoffDb = musicSettings_.PeakCutoffThresholdDb;
+
+                resultPeaks.push_back(resultPeak);
             }
         }
 
+        lock_.lock();
+        peaksExcluded_ += peaksExcluded;
+        lock_.unlock();
+
         return resultPeaks;
     }
 
-    void Approximate(const std::vector<LutResult>& y, float& a, float& b)
+    // Fits a line to the catches of all matched tracks sorted by catches, descending, and returns the largest
+    // ratio of catches to the fit, with the root mean square ratio. Ranks of equal catches are summed in closed
+    // form, so the cost depends on the distinct catch counts only, never on the number of matched tracks.
+    float EstimateApprox(const CatchHistogram& catches, float& sqAverageDelta)
     {
-        double sumX = 0;
+        double n = 0;
         double sumY = 0;
-        double sumX2 = 0;
         double sumXY = 0;
 
-        size_t n = y.size();
-
-        for (size_t i = 0; i < n; i++)
+        for (size_t value = catches.size(); value-- > 0;)
         {
-            sumX += i;
-            sumY += y[i].Catches;
-            sumX2 += i * i;
-            sumXY += i * y[i].Catches;
-        }
+            double count = catches[value];
 
-        a = (n * sumXY - (sumX * sumY)) / (n * sumX2 - sumX * sumX);
-        b = (sumY - a * sumX) / n;
-    }
+            // Ranks n .. n + count - 1 hold this value
+            sumY += value * count;
+            sumXY += value * (count * n + count * (count - 1) / 2);
+            n += count;
+        }
 
-    float EstimateApprox(const std::vector<LutResult>& y, float& sqAverageDelta)
-    {
-        if (y.size() == 0)
+        if (n == 0)
         {
             sqAverageDelta = 0;
             return 0;
         }
 
-        float a, b;
-        Approximate(y, a, b);
+        double sumX = n * (n - 1) / 2;
+        double sumX2 = (n - 1) * n * (2 * n - 1) / 6;
+
+        float a = (n * sumXY - (sumX * sumY)) / (n * sumX2 - sumX * sumX);
+        float b = (sumY - a * sumX) / n;
 
         double delta = 0;
         double maxDelta = 0;
+        double first = 0;
 
-        for (size_t i = 0; i < y.size(); i++)
+        for (size_t value = catches.size(); value-- > 0;)
         {
-            double yc = a * i + b;
-            double diff = y[i].Catches / yc;
-            delta += diff * diff;
+            double count = catches[value];
+
+            if (count == 0)
+            {
+                continue;
+            }
+
+            double last = first + count - 1;
+
+            // The ratio value / (a * i + b) is monotonic on either side of the zero of the fit line,
+            // so its largest value over the ranks is at their ends or next to that zero
+            double candidates[] = { first, last, first, last };
+            if (a != 0)
+            {
+                double zero = -static_cast<double>(b) / a;
+                candidates[2] = std::min(last, std::max(first, std::floor(zero)));
+                candidates[3] = std::min(last, std::max(first, std::ceil(zero)));
+            }
 
-            if (diff > maxDelta)
+            for (auto i : candidates)
             {
-                maxDelta = diff;
+                double diff = value / (a * i + b);
+                if (diff > maxDelta)
+                {
+                    maxDelta = diff;
+                }
             }
+
+            delta += static_cast<double>(value) * value * SumInverseSquares(a, b, first, count);
+            first += count;
         }
 
-        sqAverageDelta = std::sqrt(delta / y.size());
+        sqAverageDelta = std::sqrt(delta / n);
 
         return maxDelta;
     }
+
+    // Sum of 1 / (a * i + b)^2 over the ranks i = first .. first + count - 1. Long runs use the trigamma function,
+    // with (a * i + b)^2 = a^2 * (i + b / a)^2, split where i + b / a changes sign.
+    static double SumInverseSquares(double a, double b, double first, double count)
+    {
+        if (count <= ESTIMATE_DIRECT_SUM_RANKS || a == 0)
+        {
+            if (a == 0)
+            {
+                return count / (b * b);
+            }
+
+            double sum = 0;
+            for (double i = first; i < first + count; i++)
+            {
+                double yc = a * i + b;
+                sum += 1 / (yc * yc);
+            }
+
+            return sum;
+        }
+
+        // The ranks map to u0, u0 + 1, ..., u1
+        double u0 = first + b / a;
+        double u1 = u0 + count - 1;
+        double sum = 0;
+
+        if (u0 > 0)
+        {
+            sum = Trigamma(u0) - Trigamma(u1 + 1);
+        }
+        else if (u1 < 0)
+        {
+            sum = Trigamma(-u1) - Trigamma(-u0 + 1);
+        }
+        else
+        {
+            double negatives = std::ceil(-u0);
+            if (negatives == -u0)
+            {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            double lastNegative = u0 + negatives - 1;
+            sum = Trigamma(-lastNegative) - Trigamma(-u0 + 1) + Trigamma(lastNegative + 1) - Trigamma(u1 + 1);
+        }
+
+        return sum / (a * a);
+    }
+
+    // Sum of 1 / (x + k)^2 over k = 0, 1, ... for x > 0
+    static double Trigamma(double x)
+    {
+        double value = 0;
+
+        for (; x < 6; x++)
+        {
+            value += 1 / (x * x);
+        }
+
+        double inverse = 1 / x;
+        double inverse2 = inverse * inverse;
+
+        return value + inverse + inverse2 / 2 + inverse * inverse2 * (1.0 / 6 - inverse2 * (1.0 / 30 - inverse2 * (1.0 / 42 - inverse2 / 30)));
+    }
 };
 
 } // namespace dePhonica::Core::Api
@@ -0,0 +1,93 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SessionPool.h"
+
+#include <QMutexLocker>
+
+namespace dePhonica::Core::Api {
+
+SessionPool::SessionPool(const SessionServices& services, size_t capacity)
+    : services_(services)
+    , capacity_(capacity)
+{
+}
+
+void SessionPool::Prepare()
+{
+    QMutexLocker locker(&lock_);
+
+    while (idle_.size() < capacity_)
+    {
+        auto session = std::make_unique<SessionModel>(services_);
+        session->PrepareOnNode();
+
+        idle_.push_back(std::move(session));
+    }
+}
+
+std::unique_ptr<SessionModel> SessionPool::Acquire(const QJsonObject& sessionInfo)
+{
+    std::unique_ptr<SessionModel> session;
+
+    {
+        QMutexLocker locker(&lock_);
+
+        if (idle_.empty() == false)
+        {
+            session = std::move(idle_.back());
+            idle_.pop_back();
+            sessionsReused_++;
+        }
+    }
+
+    if (session == nullptr)
+    {
+        session = std::make_unique<SessionModel>(services_);
+    }
+
+    try
+    {
+        session->Configure(sessionInfo);
+    }
+    catch (...)
+    {
+        // An invalid definition leaves the session idle, it can serve the next request
+        Release(std::move(session));
+        throw;
+    }
+
+    return session;
+}
+
+void SessionPool::Release(std::unique_ptr<SessionModel> session)
+{
+    session->Reset();
+
+    QMutexLocker locker(&lock_);
+
+    if (idle_.size() < capacity_)
+    {
+        idle_.push_back(std::move(session));
+    }
+}
+
+size_t SessionPool::IdleCount()
+{
+    QMutexLocker locker(&lock_);
+    return idle_.size();
+}
+
+size_t SessionPool::ReusedCount()
+{
+    QMutexLocker locker(&lock_);
+    return sessionsReused_;
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,54 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONPOOL_H
+#define SESSIONPOOL_H
+
+#include <memory>
+#include <vector>
+
+#include <QJsonObject>
+#include <QMutex>
+
+#include "API/Session/SessionModel.h"
+#include "API/Session/SessionServices.h"
+
+#define SESSION_POOL_SIZE 8
+
+namespace dePhonica::Core::Api {
+
+// Idle, prepared session objects. Creating a session pops one and configures it, deleting a session
+// resets it and puts it back, so neither pays for the collect storage and the fingerprinter.
+class SessionPool
+{
+private:
+    QMutex lock_;
+
+    const SessionServices& services_;
+    size_t capacity_;
+
+    std::vector<std::unique_ptr<SessionModel>> idle_;
+    size_t sessionsReused_ = 0;
+
+public:
+    SessionPool(const SessionServices& services, size_t capacity = SESSION_POOL_SIZE);
+
+    // Fills the pool up to its capacity
+    void Prepare();
+
+    std::unique_ptr<SessionModel> Acquire(const QJsonObject& sessionInfo);
+    void Release(std::unique_ptr<SessionModel> session);
+
+    size_t IdleCount();
+    size_t ReusedCount();
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONPOOL_H
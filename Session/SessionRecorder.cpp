@@ -0,0 +1,270 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SessionRecorder.h"
+
+#include <algorithm>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <QUuid>
+
+namespace dePhonica::Core::Api {
+
+RecorderSettings RecorderSettings::FromEnvironment()
+{
+    RecorderSettings settings;
+
+    bool ok = false;
+    auto rate = qEnvironmentVariable("SESSION_RECORD_RATE").toDouble(&ok);
+    if (ok)
+    {
+        settings.Rate = std::min(1.0, std::max(0.0, rate));
+    }
+
+    if (qEnvironmentVariableIsEmpty("SESSION_RECORD_DIRECTORY") == false)
+    {
+        settings.Directory = qEnvironmentVariable("SESSION_RECORD_DIRECTORY");
+    }
+
+    return settings;
+}
+
+SessionRecording::SessionRecording(const QString& path, uint32_t sampleRate)
+    : path_(path)
+    , sampleRate_(sampleRate)
+{
+}
+
+SessionRecorder::SessionRecorder(const RecorderSettings& settings)
+    : settings_(settings)
+{
+    if (settings_.IsEnabled())
+    {
+        start(QThread::LowPriority);
+    }
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    lock_.lock();
+    isStopping_ = true;
+    isJobQueued_.wakeAll();
+    lock_.unlock();
+
+    // The writer empties the queue before it stops
+    wait();
+}
+
+std::shared_ptr<SessionRecording> SessionRecorder::Open(const QJsonObject& sessionInfo, uint32_t sampleRate)
+{
+    if (settings_.IsEnabled() == false || QRandomGenerator::global()->generateDouble() >= settings_.Rate)
+    {
+        return nullptr;
+    }
+
+    auto fileName = QString("%1-%2.dpsr")
+                        .arg(QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss"))
+                        .arg(QUuid::createUuid().toString(QUuid::WithoutBraces));
+
+    auto recording = std::make_shared<SessionRecording>(QDir(settings_.Directory).filePath(fileName), sampleRate);
+    recordingsOpened_++;
+
+    Enqueue({ recording, SessionRecording::RecordType::SessionInfo, 0, QJsonDocument(sessionInfo).toJson(QJsonDocument::Compact) }, false);
+
+    return recording;
+}
+
+void SessionRecorder::Append(const std::shared_ptr<SessionRecording>& recording, const float* samples, size_t count)
+{
+    recording->pending_.insert(recording->pending_.end(), samples, samples + count);
+
+    if (recording->pending_.size() >= SESSION_RECORD_CHUNK_SAMPLES)
+    {
+        SubmitPending(recording);
+    }
+}
+
+void SessionRecorder::Close(const std::shared_ptr<SessionRecording>& recording, const QString& sessionLog)
+{
+    SubmitPending(recording);
+
+    Enqueue({ recording, SessionRecording::RecordType::Log, recording->recordedSamples_, sessionLog.toUtf8() }, false);
+    Enqueue({ recording, SessionRecording::RecordType::End, recording->recordedSamples_, QByteArray() }, false);
+}
+
+QJsonObject SessionRecorder::ToJson() const
+{
+    QMutexLocker locker(&lock_);
+
+    return { { "enabled", settings_.IsEnabled() },
+             { "rate", settings_.Rate },
+             { "directory", settings_.Directory },
+             { "recordingsOpened", static_cast<qint64>(recordingsOpened_.load()) },
+             { "chunksQueued", static_cast<qint64>(jobs_.size()) },
+             { "chunksWritten", static_cast<qint64>(chunksWritten_.load()) },
+             { "chunksDropped", static_cast<qint64>(chunksDropped_.load()) },
+             { "bytesWritten", static_cast<qint64>(bytesWritten_.load()) } };
+}
+
+void SessionRecorder::run()
+{
+    while (true)
+    {
+        Job job;
+
+        {
+            QMutexLocker locker(&lock_);
+
+            while (jobs_.empty() && isStopping_ == false)
+            {
+                isJobQueued_.wait(&lock_);
+            }
+
+            if (jobs_.empty())
+            {
+                break;
+            }
+
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        Write(job);
+    }
+}
+
+void SessionRecorder::Enqueue(Job job, bool isDroppable)
+{
+    QMutexLocker locker(&lock_);
+
+    // A slow disk costs recorded samples, never session memory or latency
+    if (isDroppable && jobs_.size() >= SESSION_RECORD_QUEUE_LIMIT)
+    {
+        chunksDropped_++;
+        return;
+    }
+
+    jobs_.push_back(std::move(job));
+    isJobQueued_.wakeOne();
+}
+
+void SessionRecorder::SubmitPending(const std::shared_ptr<SessionRecording>& recording)
+{
+    auto& pending = recording->pending_;
+
+    if (pending.empty())
+    {
+        return;
+    }
+
+    QByteArray payload(reinterpret_cast<const char*>(pending.data()), static_cast<int>(pending.size() * sizeof(float)));
+    auto firstSample = recording->recordedSamples_;
+
+    // Dropped chunks still advance the position, readers see the gap in the first sample numbers
+    recording->recordedSamples_ += pending.size();
+    pending.clear();
+
+    Enqueue({ recording, SessionRecording::RecordType::Samples, firstSample, payload }, true);
+}
+
+void SessionRecorder::Write(Job& job)
+{
+    auto& file = job.Recording->file_;
+
+    if (job.Type == SessionRecording::RecordType::SessionInfo)
+    {
+        QDir().mkpath(QFileInfo(job.Recording->path_).absolutePath());
+
+        file.setFileName(job.Recording->path_);
+        if (file.open(QIODevice::WriteOnly) == false)
+        {
+            qWarning() << "Unable to create the session recording" << job.Recording->path_ << ":" << file.errorString();
+            return;
+        }
+
+        QDataStream header(&file);
+        header.setByteOrder(QDataStream::LittleEndian);
+        header << static_cast<quint32>(SESSION_RECORDING_MAGIC) << static_cast<quint32>(SESSION_RECORDING_VERSION)
+               << static_cast<quint32>(job.Recording->sampleRate_) << static_cast<quint32>(1)
+               << static_cast<quint64>(QDateTime::currentMSecsSinceEpoch()) << static_cast<quint64>(0);
+    }
+
+    // The file could not be created, the rest of the recording is lost
+    if (file.isOpen() == false)
+    {
+        return;
+    }
+
+    auto codec = SessionRecording::RecordCodec::Raw;
+    auto stored = job.Payload;
+
+    if (job.Type == SessionRecording::RecordType::Samples || job.Type == SessionRecording::RecordType::Log)
+    {
+        bool isShuffled = job.Type == SessionRecording::RecordType::Samples;
+
+        // qCompress prefixes the zlib stream with the big-endian raw size, the record header holds it already
+        auto compressed = qCompress(isShuffled ? Shuffle(job.Payload) : job.Payload).mid(4);
+
+        if (compressed.size() < job.Payload.size())
+        {
+            codec = isShuffled ? SessionRecording::RecordCodec::ShuffledZlib : SessionRecording::RecordCodec::Zlib;
+            stored = compressed;
+        }
+    }
+
+    QDataStream record(&file);
+    record.setByteOrder(QDataStream::LittleEndian);
+    record << static_cast<quint32>(job.Type) << static_cast<quint32>(codec) << static_cast<quint64>(job.FirstSample)
+           << static_cast<quint32>(stored.size()) << static_cast<quint32>(job.Payload.size());
+    record.writeRawData(stored.constData(), stored.size());
+
+    auto padding = (SESSION_RECORDING_ALIGNMENT - stored.size() % SESSION_RECORDING_ALIGNMENT) % SESSION_RECORDING_ALIGNMENT;
+    record.writeRawData(QByteArray(padding, '\0').constData(), padding);
+
+    file.flush();
+
+    bytesWritten_ += SESSION_RECORDING_RECORD_HEADER_BYTES + stored.size() + padding;
+    if (job.Type == SessionRecording::RecordType::Samples)
+    {
+        chunksWritten_++;
+    }
+
+    if (job.Type == SessionRecording::RecordType::End)
+    {
+        file.close();
+    }
+}
+
+QByteArray SessionRecorder::Shuffle(const QByteArray& floats)
+{
+    auto count = static_cast<size_t>(floats.size()) / sizeof(float);
+    auto source = reinterpret_cast<const uint8_t*>(floats.constData());
+
+    QByteArray shuffled(floats.size(), Qt::Uninitialized);
+    auto destination = reinterpret_cast<uint8_t*>(shuffled.data());
+
+    for (size_t byte = 0; byte < sizeof(float); byte++)
+    {
+        for (size_t n = 0; n < count; n++)
+        {
+            destination[byte * count + n] = source[n * sizeof(float) + byte];
+        }
+    }
+
+    return shuffled;
+}
+
+} // namespace dePhonica::Core::Api
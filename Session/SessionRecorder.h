@@ -0,0 +1,154 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+// Little-endian "DPSR"
+#define SESSION_RECORDING_MAGIC 0x52535044
+#define SESSION_RECORDING_VERSION 1
+#define SESSION_RECORDING_HEADER_BYTES 32
+#define SESSION_RECORDING_RECORD_HEADER_BYTES 24
+// Records start at multiples of this, so a reader may map the file and cast the headers in place
+#define SESSION_RECORDING_ALIGNMENT 8
+
+// Ten seconds at the target sample rate
+#define SESSION_RECORD_CHUNK_SAMPLES (16000 * 10)
+// Chunks waiting for the writer, further chunks are dropped and leave a gap in the recording
+#define SESSION_RECORD_QUEUE_LIMIT 256
+#define SESSION_RECORD_DIRECTORY "recordings"
+
+namespace dePhonica::Core::Api {
+
+struct RecorderSettings
+{
+    // Share of sessions recorded, 0 - none, 1 - all
+    double Rate = 0;
+    QString Directory = SESSION_RECORD_DIRECTORY;
+
+    bool IsEnabled() const { return Rate > 0; }
+
+    // SESSION_RECORD_RATE and SESSION_RECORD_DIRECTORY
+    static RecorderSettings FromEnvironment();
+};
+
+// Recording file of one session. The file starts with a header of SESSION_RECORDING_HEADER_BYTES:
+//   u32 magic, u32 version, u32 sample rate, u32 channels, u64 creation time in ms since epoch, u64 reserved
+// followed by records, each aligned to SESSION_RECORDING_ALIGNMENT and zero padded:
+//   u32 type, u32 codec, u64 first sample, u32 stored bytes, u32 raw bytes, payload of stored bytes
+// Record types are RecordType, the payload codecs are RecordCodec. Records are only ever appended and
+// every record is flushed, so a live recording can be read up to its last complete record.
+class SessionRecording
+{
+public:
+    enum class RecordType : uint32_t
+    {
+        SessionInfo = 1, // compact JSON of the session definition
+        Samples = 2,     // float32 mono samples starting at the first sample
+        Log = 3,         // session log text
+        End = 4          // no payload, the session has finished
+    };
+
+    enum class RecordCodec : uint32_t
+    {
+        Raw = 0,
+        Zlib = 1,
+        // The bytes of every float regrouped by significance - all low bytes, ..., all sign and exponent
+        // bytes - then zlib, which compresses the slowly changing high bytes far better than plain floats
+        ShuffledZlib = 2
+    };
+
+private:
+    friend class SessionRecorder;
+
+    QString path_;
+    uint32_t sampleRate_;
+    QFile file_;
+
+    // Session side: samples waiting to fill a chunk and the number handed to the writer or dropped
+    std::vector<float> pending_;
+    uint64_t recordedSamples_ = 0;
+
+public:
+    SessionRecording(const QString& path, uint32_t sampleRate);
+
+    const QString& Path() const { return path_; }
+};
+
+// Writes sampled session recordings on a background thread. Sessions hand over chunks of samples as
+// they arrive, compression and file writes never run on the session or request threads.
+class SessionRecorder : public QThread
+{
+    Q_OBJECT
+
+private:
+    struct Job
+    {
+        std::shared_ptr<SessionRecording> Recording;
+        SessionRecording::RecordType Type;
+        uint64_t FirstSample;
+        QByteArray Payload;
+    };
+
+    mutable QMutex lock_;
+    QWaitCondition isJobQueued_;
+
+    RecorderSettings settings_;
+
+    std::deque<Job> jobs_;
+    bool isStopping_ = false;
+
+    std::atomic<uint64_t> recordingsOpened_ { 0 };
+    std::atomic<uint64_t> chunksWritten_ { 0 };
+    std::atomic<uint64_t> chunksDropped_ { 0 };
+    std::atomic<uint64_t> bytesWritten_ { 0 };
+
+public:
+    SessionRecorder(const RecorderSettings& settings = RecorderSettings::FromEnvironment());
+    ~SessionRecorder();
+
+    // Decides by the recording rate whether the session is recorded, returns nullptr if it is not
+    std::shared_ptr<SessionRecording> Open(const QJsonObject& sessionInfo, uint32_t sampleRate);
+
+    // Called by the owning session only, never concurrently for one recording
+    void Append(const std::shared_ptr<SessionRecording>& recording, const float* samples, size_t count);
+
+    // Writes the samples still pending, the log and the end record, then closes the file
+    void Close(const std::shared_ptr<SessionRecording>& recording, const QString& sessionLog);
+
+    QJsonObject ToJson() const;
+
+protected:
+    void run() override;
+
+private:
+    void Enqueue(Job job, bool isDroppable);
+    void SubmitPending(const std::shared_ptr<SessionRecording>& recording);
+
+    void Write(Job& job);
+
+    static QByteArray Shuffle(const QByteArray& floats);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONRECORDER_H
@@ -0,0 +1,43 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONSERVICES_H
+#define SESSIONSERVICES_H
+
+#include "API/Search/CatalogueSearchPool.h"
+#include "API/Search/NumaTopology.h"
+#include "API/Search/SearchScheduler.h"
+#include "API/Session/ClientRegistry.h"
+#include "API/Session/SessionRecorder.h"
+#include "API/Session/SharedSearchRegistry.h"
+#include "API/Session/TrackNameCache.h"
+#include "API/Shards/ShardSettings.h"
+#include "Interfaces/ICoreInstance.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core::Interfaces;
+
+// Process-wide services shared by all sessions, owned by SessionApiModel
+struct SessionServices
+{
+    const ICoreInstance& CoreInstance;
+    SearchScheduler& Scheduler;
+    NumaTopology& Topology;
+    CatalogueSearchPool& CatalogueSearches;
+    TrackNameCache& TrackNames;
+    SharedSearchRegistry& SharedSearches;
+    SessionRecorder& Recorder;
+    ClientRegistry& Clients;
+    const ShardSettings& Shards;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONSERVICES_H
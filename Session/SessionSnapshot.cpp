@@ -0,0 +1,181 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SessionSnapshot.h"
+
+#include <cmath>
+
+#include <QDataStream>
+#include <QtEndian>
+#include <QJsonDocument>
+
+#include "CoreException.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+QByteArray SessionSnapshot::Serialize() const
+{
+    QByteArray snapshotData;
+    QDataStream stream(&snapshotData, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    stream << static_cast<quint32>(SESSION_SNAPSHOT_MAGIC) << static_cast<quint32>(SESSION_SNAPSHOT_VERSION);
+    stream << QJsonDocument(SessionInfo).toJson(QJsonDocument::Compact);
+
+    stream << static_cast<quint64>(Samples.size());
+    stream.writeRawData(reinterpret_cast<const char*>(Samples.data()), static_cast<int>(Samples.size() * sizeof(float)));
+
+    stream << static_cast<quint32>(FragmentPeaks.size());
+    for (const auto& peak : FragmentPeaks)
+    {
+        stream << static_cast<quint32>(peak.BandIndex) << static_cast<quint32>(peak.ChunkIndex) << static_cast<float>(peak.PeakCutoffDb);
+    }
+
+    stream << static_cast<quint32>(SearchResult.size());
+    for (const auto& result : SearchResult)
+    {
+        stream << static_cast<quint64>(result.TrackIndex) << static_cast<quint64>(result.ChunkIndex) << static_cast<quint64>(result.Catches);
+    }
+
+    stream << ResultVersion << MaxResultDelta << SqAverageDelta << IsPartialResult;
+
+    return qCompress(snapshotData);
+}
+
+SessionSnapshot SessionSnapshot::Deserialize(const QByteArray& compressedData)
+{
+    // qCompress prefixes the zlib stream with the big-endian uncompressed size, check it before inflating
+    if (compressedData.size() < 4)
+    {
+        throw CoreException("Invalid session snapshot - truncated data");
+    }
+
+    auto declaredSize = qFromBigEndian<quint32>(compressedData.constData());
+    if (declaredSize > SESSION_SNAPSHOT_MAX_BYTES)
+    {
+        throw CoreException(QString("Invalid session snapshot - larger than %1 bytes uncompressed").arg(SESSION_SNAPSHOT_MAX_BYTES));
+    }
+
+    auto snapshotData = qUncompress(compressedData);
+    if (snapshotData.isEmpty() || static_cast<quint32>(snapshotData.size()) != declaredSize)
+    {
+        throw CoreException("Invalid session snapshot - corrupted compressed data");
+    }
+
+    QDataStream stream(snapshotData);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+
+    if (magic != SESSION_SNAPSHOT_MAGIC || version != SESSION_SNAPSHOT_VERSION)
+    {
+        throw CoreException("Invalid session snapshot - unknown format or version");
+    }
+
+    SessionSnapshot snapshot;
+
+    QByteArray sessionInfo;
+    stream >> sessionInfo;
+    snapshot.SessionInfo = QJsonDocument::fromJson(sessionInfo).object();
+
+    quint64 samplesCount = 0;
+    stream >> samplesCount;
+
+    // Compared without multiplying, a crafted count must not overflow past the check
+    if (samplesCount > SESSION_SNAPSHOT_MAX_SAMPLES || samplesCount > static_cast<quint64>(snapshotData.size()) / sizeof(float))
+    {
+        throw CoreException("Invalid session snapshot - truncated samples");
+    }
+
+    snapshot.Samples.resize(samplesCount);
+    stream.readRawData(reinterpret_cast<char*>(snapshot.Samples.data()), static_cast<int>(samplesCount * sizeof(float)));
+
+    quint32 peaksCount = 0;
+    stream >> peaksCount;
+
+    for (quint32 n = 0; n < peaksCount && stream.status() == QDataStream::Ok; n++)
+    {
+        quint32 bandIndex, chunkIndex;
+        float peakCutoffDb;
+        stream >> bandIndex >> chunkIndex >> peakCutoffDb;
+
+        PeakDescription peak;
+        peak.BandIndex = bandIndex;
+        peak.ChunkIndex = chunkIndex;
+        peak.PeakCutoffDb = peakCutoffDb;
+        snapshot.FragmentPeaks.push_back(peak);
+    }
+
+    quint32 resultsCount = 0;
+    stream >> resultsCount;
+
+    for (quint32 n = 0; n < resultsCount && stream.status() == QDataStream::Ok; n++)
+    {
+        quint64 trackIndex, chunkIndex, catches;
+        stream >> trackIndex >> chunkIndex >> catches;
+
+        LutResult result;
+        result.TrackIndex = static_cast<decltype(result.TrackIndex)>(trackIndex);
+        result.ChunkIndex = static_cast<decltype(result.ChunkIndex)>(chunkIndex);
+        result.Catches = static_cast<decltype(result.Catches)>(catches);
+        snapshot.SearchResult.push_back(result);
+    }
+
+    stream >> snapshot.ResultVersion >> snapshot.MaxResultDelta >> snapshot.SqAverageDelta >> snapshot.IsPartialResult;
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        throw CoreException("Invalid session snapshot - truncated data");
+    }
+
+    return snapshot;
+}
+
+void SessionSnapshot::Validate(const MusicSettings& musicSettings, size_t maxTrackCount) const
+{
+    auto chunkStepSeconds = static_cast<double>(musicSettings.SliceDurationSeconds - musicSettings.SliceOverlapSeconds);
+    auto maxFragmentChunks = static_cast<quint64>(static_cast<double>(SESSION_SNAPSHOT_MAX_SECONDS) / chunkStepSeconds) + 1;
+    auto maxTrackChunks = static_cast<quint64>(static_cast<double>(SESSION_SNAPSHOT_MAX_TRACK_SECONDS) / chunkStepSeconds);
+
+    for (const auto& peak : FragmentPeaks)
+    {
+        if (static_cast<quint64>(peak.BandIndex) >= static_cast<quint64>(musicSettings.FrequencyPoints) ||
+            static_cast<quint64>(peak.ChunkIndex) >= maxFragmentChunks)
+        {
+            throw CoreException(QString("Invalid session snapshot - peak out of range, band %1, chunk %2").arg(peak.BandIndex).arg(peak.ChunkIndex));
+        }
+    }
+
+    // The aggregated result holds one entry per track at most
+    if (SearchResult.size() > maxTrackCount)
+    {
+        throw CoreException(QString("Invalid session snapshot - %1 results for a catalogue of %2 tracks").arg(SearchResult.size()).arg(maxTrackCount));
+    }
+
+    for (const auto& result : SearchResult)
+    {
+        if (static_cast<quint64>(result.TrackIndex) >= maxTrackCount || static_cast<quint64>(result.ChunkIndex) > maxTrackChunks)
+        {
+            throw CoreException(
+                QString("Invalid session snapshot - result out of range, track %1, chunk %2").arg(result.TrackIndex).arg(result.ChunkIndex));
+        }
+    }
+
+    if (std::isfinite(MaxResultDelta) == false || std::isfinite(SqAverageDelta) == false)
+    {
+        throw CoreException("Invalid session snapshot - result statistics are not finite");
+    }
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,61 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONSNAPSHOT_H
+#define SESSIONSNAPSHOT_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QJsonObject>
+
+#include "Engine/Fingerprinter.h"
+#include "Engine/SearchHashesWorker.h"
+
+#define SESSION_SNAPSHOT_MAGIC 0x64505353
+#define SESSION_SNAPSHOT_VERSION 1
+// Audio carried by a snapshot, older audio of longer sessions is not exported
+#define SESSION_SNAPSHOT_MAX_SECONDS 600
+#define SESSION_SNAPSHOT_MAX_SAMPLES (16000 * SESSION_SNAPSHOT_MAX_SECONDS)
+// Uncompressed snapshot size accepted by Deserialize - the audio plus room for peaks, results and definition
+#define SESSION_SNAPSHOT_MAX_BYTES (SESSION_SNAPSHOT_MAX_SAMPLES * 4 + 16 * 1024 * 1024)
+// Longest catalogue track position a result may point at
+#define SESSION_SNAPSHOT_MAX_TRACK_SECONDS (24 * 3600)
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::MusicSearch;
+
+// State needed to continue a session on another node - its definition, collected audio,
+// the voted peaks of the last fingerprint and the last search result
+struct SessionSnapshot
+{
+    QJsonObject SessionInfo;
+
+    std::vector<float> Samples;
+    std::vector<PeakDescription> FragmentPeaks;
+
+    std::vector<LutResult> SearchResult;
+    quint64 ResultVersion = 0;
+    float MaxResultDelta = 0;
+    float SqAverageDelta = 0;
+    bool IsPartialResult = false;
+
+    // zlib compressed little-endian binary. Deserialize throws CoreException on any malformed or oversized input
+    QByteArray Serialize() const;
+    static SessionSnapshot Deserialize(const QByteArray& snapshotData);
+
+    // Checks the peaks and results against the fingerprint settings and the catalogue of this node, throws
+    // CoreException if any is out of range. A well-formed snapshot from a node with another catalogue fails here.
+    void Validate(const MusicSettings& musicSettings, size_t maxTrackCount) const;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONSNAPSHOT_H
@@ -0,0 +1,79 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SessionUsage.h"
+
+#include <QtGlobal>
+
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+#include "CoreException.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+
+void SessionUsage::Reset()
+{
+    for (auto counter : { &BufferBytes, &QueuedRequests, &SearchesRun, &FingerprintCpuMicroseconds, &CompareMicroseconds, &LastSearchMicroseconds })
+    {
+        Set(*counter, 0);
+    }
+}
+
+QStringList SessionUsage::Measures()
+{
+    return { "bufferBytes", "queuedRequests", "searchesRun", "fingerprintCpuMs", "compareMs", "lastSearchMs" };
+}
+
+uint64_t SessionUsage::Measure(const QString& measure) const
+{
+    const std::atomic<uint64_t>* counters[] = { &BufferBytes, &QueuedRequests, &SearchesRun,
+                                                &FingerprintCpuMicroseconds, &CompareMicroseconds, &LastSearchMicroseconds };
+
+    auto index = Measures().indexOf(measure);
+
+    if (index < 0)
+    {
+        throw CoreException(QString("Unknown session measure: %1. Valid values are: %2").arg(measure).arg(Measures().join(", ")));
+    }
+
+    return counters[index]->load(std::memory_order_relaxed);
+}
+
+QJsonObject SessionUsage::ToJson() const
+{
+    auto milliseconds = [](const std::atomic<uint64_t>& microseconds) {
+        return static_cast<double>(microseconds.load(std::memory_order_relaxed)) / 1000;
+    };
+
+    return { { "bufferBytes", static_cast<qint64>(BufferBytes.load(std::memory_order_relaxed)) },
+             { "queuedRequests", static_cast<qint64>(QueuedRequests.load(std::memory_order_relaxed)) },
+             { "searchesRun", static_cast<qint64>(SearchesRun.load(std::memory_order_relaxed)) },
+             { "fingerprintCpuMs", milliseconds(FingerprintCpuMicroseconds) },
+             { "compareMs", milliseconds(CompareMicroseconds) },
+             { "lastSearchMs", milliseconds(LastSearchMicroseconds) } };
+}
+
+uint64_t SessionUsage::ThreadCpuMicroseconds()
+{
+#ifdef Q_OS_UNIX
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0)
+    {
+        return static_cast<uint64_t>(time.tv_sec) * 1000000 + static_cast<uint64_t>(time.tv_nsec) / 1000;
+    }
+#endif
+
+    return 0;
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,54 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SESSIONUSAGE_H
+#define SESSIONUSAGE_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <QJsonObject>
+#include <QStringList>
+
+namespace dePhonica::Core::Api {
+
+// Resources used by one session. Counters are written by the session without its lock and read
+// by the admin view at any time, so every field is a relaxed atomic and a reading may mix searches.
+struct SessionUsage
+{
+    std::atomic<uint64_t> BufferBytes { 0 };
+    std::atomic<uint64_t> QueuedRequests { 0 };
+    std::atomic<uint64_t> SearchesRun { 0 };
+
+    // CPU time of the session thread while fingerprinting
+    std::atomic<uint64_t> FingerprintCpuMicroseconds { 0 };
+    // Wall time of the comparison, it runs on the pooled search workers or on the shards
+    std::atomic<uint64_t> CompareMicroseconds { 0 };
+    std::atomic<uint64_t> LastSearchMicroseconds { 0 };
+
+    void Reset();
+
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value) { counter.fetch_add(value, std::memory_order_relaxed); }
+    static void Set(std::atomic<uint64_t>& counter, uint64_t value) { counter.store(value, std::memory_order_relaxed); }
+
+    // Names accepted by Measure, in the order of ToJson
+    static QStringList Measures();
+
+    // Throws CoreException for an unknown measure
+    uint64_t Measure(const QString& measure) const;
+
+    QJsonObject ToJson() const;
+
+    // CPU time consumed by the calling thread so far
+    static uint64_t ThreadCpuMicroseconds();
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SESSIONUSAGE_H
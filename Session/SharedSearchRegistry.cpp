@@ -0,0 +1,269 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "SharedSearchRegistry.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include <QDeadlineTimer>
+
+namespace dePhonica::Core::Api {
+
+std::vector<PeakDescription> PeakSketch::RecentPeaks(const std::vector<PeakDescription>& peaks)
+{
+    size_t lastChunk = 0;
+    for (const auto& peak : peaks)
+    {
+        lastChunk = std::max<size_t>(lastChunk, peak.ChunkIndex);
+    }
+
+    size_t firstChunk = lastChunk >= SHARED_SEARCH_WINDOW_CHUNKS ? lastChunk - SHARED_SEARCH_WINDOW_CHUNKS + 1 : 0;
+
+    std::vector<PeakDescription> recentPeaks;
+    std::copy_if(peaks.begin(), peaks.end(), std::back_inserter(recentPeaks), [firstChunk](const PeakDescription& peak) {
+        return peak.ChunkIndex >= firstChunk;
+    });
+
+    std::sort(recentPeaks.begin(), recentPeaks.end(), [](const PeakDescription& a, const PeakDescription& b) {
+        return a.ChunkIndex < b.ChunkIndex;
+    });
+
+    return recentPeaks;
+}
+
+PeakSketch PeakSketch::FromPeaks(const std::vector<PeakDescription>& peaks)
+{
+    PeakSketch sketch;
+
+    if (peaks.empty())
+    {
+        return sketch;
+    }
+
+    auto recentPeaks = RecentPeaks(peaks);
+
+    for (size_t n = 0; n < recentPeaks.size(); n++)
+    {
+        for (size_t m = n + 1; m < recentPeaks.size(); m++)
+        {
+            size_t chunkDistance = recentPeaks[m].ChunkIndex - recentPeaks[n].ChunkIndex;
+
+            if (chunkDistance > SHARED_SEARCH_PAIR_CHUNKS)
+            {
+                break;
+            }
+
+            if (chunkDistance == 0)
+            {
+                continue;
+            }
+
+            uint64_t feature = static_cast<uint64_t>(recentPeaks[n].BandIndex) | (static_cast<uint64_t>(recentPeaks[m].BandIndex) << 20) |
+                               (static_cast<uint64_t>(chunkDistance) << 40);
+
+            // splitmix64 finalizer
+            uint64_t hash = feature + 0x9e3779b97f4a7c15ull;
+            hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+            hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+            hash = hash ^ (hash >> 31);
+
+            auto& bucket = sketch.buckets_[hash % SHARED_SEARCH_SKETCH_SIZE];
+            bucket = std::min(bucket, static_cast<uint32_t>(hash >> 32));
+
+            sketch.featuresCount_++;
+        }
+    }
+
+    return sketch;
+}
+
+float PeakSketch::Similarity(const PeakSketch& other) const
+{
+    size_t bucketsUsed = 0;
+    size_t bucketsMatched = 0;
+
+    for (size_t n = 0; n < SHARED_SEARCH_SKETCH_SIZE; n++)
+    {
+        if (buckets_[n] == emptyBucket && other.buckets_[n] == emptyBucket)
+        {
+            continue;
+        }
+
+        bucketsUsed++;
+        bucketsMatched += buckets_[n] == other.buckets_[n] ? 1 : 0;
+    }
+
+    return bucketsUsed > 0 ? static_cast<float>(bucketsMatched) / bucketsUsed : 0.0f;
+}
+
+std::shared_ptr<SharedSearch> SharedSearchRegistry::Join(const PeakSketch& sketch,
+                                                         const std::vector<PeakDescription>& fragmentPeaks,
+                                                         uint64_t sessionKey,
+                                                         bool& isLeader)
+{
+    QMutexLocker locker(&lock_);
+
+    RemoveExpired();
+
+    std::shared_ptr<SharedSearch> bestSearch;
+    float bestSimilarity = SHARED_SEARCH_SIMILARITY;
+
+    for (const auto& search : searches_)
+    {
+        if (search->LeaderKey == sessionKey)
+        {
+            continue;
+        }
+
+        float similarity = search->Sketch.Similarity(sketch);
+
+        if (similarity >= bestSimilarity)
+        {
+            bestSimilarity = similarity;
+            bestSearch = search;
+        }
+    }
+
+    if (bestSearch)
+    {
+        bestSearch->SubscribersCount++;
+        isLeader = false;
+
+        return bestSearch;
+    }
+
+    auto search = std::make_shared<SharedSearch>();
+    search->Sketch = sketch;
+    search->LeaderKey = sessionKey;
+    search->LeaderPeaks = PeakSketch::RecentPeaks(fragmentPeaks);
+    searches_.push_back(search);
+
+    isLeader = true;
+
+    return search;
+}
+
+void SharedSearchRegistry::Complete(const std::shared_ptr<SharedSearch>& search,
+                                    const std::vector<LutResult>& searchResult,
+                                    float maxResultDelta,
+                                    float sqAverageDelta,
+                                    bool isPartialResult)
+{
+    QMutexLocker locker(&lock_);
+
+    search->SearchResult = searchResult;
+    search->MaxResultDelta = maxResultDelta;
+    search->SqAverageDelta = sqAverageDelta;
+    search->IsPartialResult = isPartialResult;
+    search->IsReady = true;
+    search->ReadyTimer.start();
+
+    isSearchCompleted_.wakeAll();
+}
+
+void SharedSearchRegistry::Abandon(const std::shared_ptr<SharedSearch>& search)
+{
+    QMutexLocker locker(&lock_);
+
+    search->IsAbandoned = true;
+    searches_.remove(search);
+
+    isSearchCompleted_.wakeAll();
+}
+
+bool SharedSearchRegistry::Wait(const std::shared_ptr<SharedSearch>& search, qint64 timeoutMilliseconds)
+{
+    QDeadlineTimer deadline(timeoutMilliseconds);
+    QMutexLocker locker(&lock_);
+
+    while (search->IsReady == false && search->IsAbandoned == false)
+    {
+        if (isSearchCompleted_.wait(&lock_, deadline) == false)
+        {
+            break;
+        }
+    }
+
+    return search->IsReady;
+}
+
+bool SharedSearchRegistry::Rebase(const SharedSearch& search, const std::vector<PeakDescription>& followerPeaks, std::vector<LutResult>& followerResult)
+{
+    const auto& leaderPeaks = search.LeaderPeaks;
+    auto recentPeaks = PeakSketch::RecentPeaks(followerPeaks);
+
+    if (leaderPeaks.empty() || recentPeaks.empty())
+    {
+        return false;
+    }
+
+    auto peakKey = [](size_t bandIndex, long long chunkIndex) { return static_cast<uint64_t>(bandIndex) | (static_cast<uint64_t>(chunkIndex) << 20); };
+
+    std::unordered_set<uint64_t> leaderKeys;
+    for (const auto& peak : leaderPeaks)
+    {
+        leaderKeys.insert(peakKey(peak.BandIndex, peak.ChunkIndex));
+    }
+
+    // Both fragments end at about the same stream moment, so the offset between their starts is close to
+    // the difference of their last chunks. A follower chunk c holds the same audio as leader chunk c + offset.
+    long long expectedOffset = static_cast<long long>(leaderPeaks.back().ChunkIndex) - static_cast<long long>(recentPeaks.back().ChunkIndex);
+
+    long long bestOffset = 0;
+    size_t bestMatches = 0;
+
+    for (long long offset = expectedOffset - SHARED_SEARCH_ALIGN_CHUNKS; offset <= expectedOffset + SHARED_SEARCH_ALIGN_CHUNKS; offset++)
+    {
+        size_t matches = 0;
+
+        for (const auto& peak : recentPeaks)
+        {
+            auto leaderChunk = static_cast<long long>(peak.ChunkIndex) + offset;
+            matches += leaderChunk >= 0 && leaderKeys.count(peakKey(peak.BandIndex, leaderChunk)) > 0 ? 1 : 0;
+        }
+
+        if (matches > bestMatches)
+        {
+            bestMatches = matches;
+            bestOffset = offset;
+        }
+    }
+
+    if (bestMatches < SHARED_SEARCH_ALIGN_MATCH * std::min(leaderPeaks.size(), recentPeaks.size()))
+    {
+        return false;
+    }
+
+    // The leader matched its chunk 0 at ChunkIndex, the follower's chunk 0 is the leader's chunk bestOffset
+    followerResult.clear();
+
+    for (auto result : search.SearchResult)
+    {
+        auto chunkIndex = static_cast<long long>(result.ChunkIndex) + bestOffset;
+        if (chunkIndex < 0)
+        {
+            continue;
+        }
+
+        result.ChunkIndex = chunkIndex;
+        followerResult.push_back(result);
+    }
+
+    return true;
+}
+
+void SharedSearchRegistry::RemoveExpired()
+{
+    searches_.remove_if([](const std::shared_ptr<SharedSearch>& search) {
+        return search->IsAbandoned || (search->IsReady && search->ReadyTimer.elapsed() > SHARED_SEARCH_TTL_MILLISECONDS);
+    });
+}
+
+} // namespace dePhonica::Core::Api
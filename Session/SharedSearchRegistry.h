@@ -0,0 +1,160 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHAREDSEARCHREGISTRY_H
+#define SHAREDSEARCHREGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+
+#include "Engine/Fingerprinter.h"
+#include "Engine/SearchHashesWorker.h"
+
+#define SHARED_SEARCH_SKETCH_SIZE 128
+#define SHARED_SEARCH_WINDOW_CHUNKS 64
+#define SHARED_SEARCH_PAIR_CHUNKS 4
+#define SHARED_SEARCH_SIMILARITY 0.5f
+#define SHARED_SEARCH_TTL_MILLISECONDS 2000
+#define SHARED_SEARCH_WAIT_MILLISECONDS 5000
+// Chunks around the expected offset searched when a follower aligns its fragment with the leader's one
+#define SHARED_SEARCH_ALIGN_CHUNKS 8
+// Share of the recent peaks which must align for the leader's result to be re-based onto the follower
+#define SHARED_SEARCH_ALIGN_MATCH 0.5f
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::MusicSearch;
+
+// One-permutation MinHash of the recent fingerprint peaks. Features are peak pairs described by
+// both bands and their chunk distance, so sessions joining the same stream at different moments
+// produce comparable sketches.
+class PeakSketch
+{
+private:
+    static constexpr uint32_t emptyBucket = 0xffffffff;
+
+    std::array<uint32_t, SHARED_SEARCH_SKETCH_SIZE> buckets_;
+    size_t featuresCount_ = 0;
+
+public:
+    PeakSketch() { buckets_.fill(emptyBucket); }
+
+    static PeakSketch FromPeaks(const std::vector<PeakDescription>& peaks);
+
+    // Peaks of the last SHARED_SEARCH_WINDOW_CHUNKS chunks, ordered by chunk
+    static std::vector<PeakDescription> RecentPeaks(const std::vector<PeakDescription>& peaks);
+
+    bool IsEmpty() const { return featuresCount_ == 0; }
+    float Similarity(const PeakSketch& other) const;
+};
+
+// Result of one search run on behalf of every session whose sketch matched the leader's one. Sessions
+// joined the stream at different moments, so their fragments start at different stream positions:
+// followers align their recent peaks with the leader's ones and re-base the match positions.
+struct SharedSearch
+{
+    PeakSketch Sketch;
+    uint64_t LeaderKey = 0;
+
+    // Recent peaks of the leader's fragment, set on creation and never changed
+    std::vector<PeakDescription> LeaderPeaks;
+
+    bool IsReady = false;
+    bool IsAbandoned = false;
+    size_t SubscribersCount = 1;
+    QElapsedTimer ReadyTimer;
+
+    std::vector<LutResult> SearchResult;
+    float MaxResultDelta = 0;
+    float SqAverageDelta = 0;
+    bool IsPartialResult = false;
+};
+
+class SharedSearchRegistry
+{
+private:
+    QMutex lock_;
+    QWaitCondition isSearchCompleted_;
+
+    std::list<std::shared_ptr<SharedSearch>> searches_;
+
+    std::atomic<uint64_t> nextSessionKey_ { 1 };
+
+public:
+    // Identifies one configured session - pooled session objects get a new key on every reuse
+    uint64_t NewSessionKey() { return nextSessionKey_++; }
+
+    // Attaches to a pending or fresh search of a matching stream led by another session, or registers
+    // a new one which the caller then leads and must Complete or Abandon
+    std::shared_ptr<SharedSearch> Join(const PeakSketch& sketch, const std::vector<PeakDescription>& fragmentPeaks, uint64_t sessionKey, bool& isLeader);
+
+    void Complete(const std::shared_ptr<SharedSearch>& search,
+                  const std::vector<LutResult>& searchResult,
+                  float maxResultDelta,
+                  float sqAverageDelta,
+                  bool isPartialResult);
+    void Abandon(const std::shared_ptr<SharedSearch>& search);
+
+    // Waits for the leader, returns false when the search was abandoned or the timeout expired
+    bool Wait(const std::shared_ptr<SharedSearch>& search, qint64 timeoutMilliseconds);
+
+    // Copies the leader's result with its match positions moved to the follower's fragment. Returns false
+    // when the recent peaks of both fragments do not align, the follower then searches on its own.
+    static bool Rebase(const SharedSearch& search, const std::vector<PeakDescription>& followerPeaks, std::vector<LutResult>& followerResult);
+
+private:
+    void RemoveExpired();
+};
+
+// Abandons a led search unless its result was completed, so waiting sessions fall back to own searches
+class SharedSearchLeadership
+{
+private:
+    SharedSearchRegistry& registry_;
+    std::shared_ptr<SharedSearch> search_;
+
+public:
+    SharedSearchLeadership(SharedSearchRegistry& registry, const std::shared_ptr<SharedSearch>& search)
+        : registry_(registry)
+        , search_(search)
+    {
+    }
+
+    ~SharedSearchLeadership()
+    {
+        if (search_)
+        {
+            registry_.Abandon(search_);
+        }
+    }
+
+    void Complete(const std::vector<LutResult>& searchResult, float maxResultDelta, float sqAverageDelta, bool isPartialResult)
+    {
+        if (search_)
+        {
+            registry_.Complete(search_, searchResult, maxResultDelta, sqAverageDelta, isPartialResult);
+            search_.reset();
+        }
+    }
+
+    SharedSearchLeadership(const SharedSearchLeadership&) = delete;
+    SharedSearchLeadership& operator=(const SharedSearchLeadership&) = delete;
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHAREDSEARCHREGISTRY_H
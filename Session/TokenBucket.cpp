@@ -0,0 +1,56 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "TokenBucket.h"
+
+#include <algorithm>
+
+namespace dePhonica::Core::Api {
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate_(std::max(0.0, rate))
+    , burst_(std::max({ 1.0, burst, rate_ }))
+    , tokens_(burst_)
+{
+    refillTimer_.start();
+}
+
+bool TokenBucket::TryTake(double tokens)
+{
+    if (IsLimited() == false)
+    {
+        return true;
+    }
+
+    Refill();
+
+    if (tokens_ < tokens)
+    {
+        return false;
+    }
+
+    tokens_ -= tokens;
+    return true;
+}
+
+double TokenBucket::Tokens()
+{
+    Refill();
+    return tokens_;
+}
+
+void TokenBucket::Refill()
+{
+    auto elapsedNanoseconds = refillTimer_.nsecsElapsed();
+    refillTimer_.start();
+
+    tokens_ = std::min(burst_, tokens_ + rate_ * static_cast<double>(elapsedNanoseconds) / 1e9);
+}
+
+} // namespace dePhonica::Core::Api
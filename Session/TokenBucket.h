@@ -0,0 +1,43 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QElapsedTimer>
+
+namespace dePhonica::Core::Api {
+
+// Allows Rate operations per second on average and bursts of up to Burst operations.
+// A zero rate means no limit. Not thread safe.
+class TokenBucket
+{
+private:
+    double rate_;
+    double burst_;
+    double tokens_;
+
+    QElapsedTimer refillTimer_;
+
+public:
+    TokenBucket(double rate = 0, double burst = 0);
+
+    bool IsLimited() const { return rate_ > 0; }
+
+    bool TryTake(double tokens = 1);
+
+    double Tokens();
+
+private:
+    void Refill();
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // TOKENBUCKET_H
@@ -0,0 +1,117 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef TRACKNAMECACHE_H
+#define TRACKNAMECACHE_H
+
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+
+#include <QReadLocker>
+#include <QReadWriteLock>
+#include <QString>
+#include <QWriteLocker>
+
+#include "Interfaces/ICoreInstance.h"
+
+#define TRACK_NAME_CACHE_CAPACITY 100000
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core::Interfaces;
+
+// Process-wide interned track names shared by all sessions. QString is implicitly shared,
+// so a cache hit costs a lookup and a reference count increment. A full cache evicts with the
+// clock algorithm: hits only set a flag under the read lock, and the eviction hand skips names
+// hit since it last passed, so the names of popular tracks stay cached.
+class TrackNameCache
+{
+private:
+    struct Entry
+    {
+        size_t TrackIndex;
+        QString Name;
+        std::atomic<bool> IsReferenced { false };
+
+        Entry(size_t trackIndex, const QString& name)
+            : TrackIndex(trackIndex)
+            , Name(name)
+        {
+        }
+    };
+
+    QReadWriteLock lock_;
+
+    const ICoreInstance& coreInstance_;
+
+    // Entries never move, a deque grows without relocating them
+    std::deque<Entry> entries_;
+    std::unordered_map<size_t, size_t> entryByTrack_;
+    size_t hand_ = 0;
+
+public:
+    TrackNameCache(const ICoreInstance& coreInstance)
+        : coreInstance_(coreInstance)
+    {
+    }
+
+    QString GetFileName(size_t trackIndex)
+    {
+        {
+            QReadLocker locker(&lock_);
+
+            auto entryIterator = entryByTrack_.find(trackIndex);
+            if (entryIterator != entryByTrack_.end())
+            {
+                auto& entry = entries_[entryIterator->second];
+                entry.IsReferenced.store(true, std::memory_order_relaxed);
+                return entry.Name;
+            }
+        }
+
+        QString fileName = coreInstance_.GetFileNameByIndex(trackIndex);
+
+        QWriteLocker locker(&lock_);
+
+        // Another thread may have added the name meanwhile
+        auto entryIterator = entryByTrack_.find(trackIndex);
+        if (entryIterator != entryByTrack_.end())
+        {
+            return entries_[entryIterator->second].Name;
+        }
+
+        if (entries_.size() < TRACK_NAME_CACHE_CAPACITY)
+        {
+            entries_.emplace_back(trackIndex, fileName);
+            entryByTrack_.emplace(trackIndex, entries_.size() - 1);
+            return fileName;
+        }
+
+        while (entries_[hand_].IsReferenced.exchange(false, std::memory_order_relaxed))
+        {
+            hand_ = (hand_ + 1) % entries_.size();
+        }
+
+        auto& victim = entries_[hand_];
+        entryByTrack_.erase(victim.TrackIndex);
+
+        victim.TrackIndex = trackIndex;
+        victim.Name = fileName;
+        entryByTrack_.emplace(trackIndex, hand_);
+
+        hand_ = (hand_ + 1) % entries_.size();
+
+        return fileName;
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // TRACKNAMECACHE_H
@@ -0,0 +1,74 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHARDAPIMODEL_H
+#define SHARDAPIMODEL_H
+
+#include <vector>
+
+#include <QDeadlineTimer>
+#include <QJsonObject>
+
+#include "API/Search/CatalogueSearchPool.h"
+#include "API/Search/SearchScheduler.h"
+#include "API/Session/SessionServices.h"
+#include "API/Shards/ShardProtocol.h"
+
+// Scheduler client of the shard requests, they queue fairly against the sessions of this node
+#define SHARD_CLIENT_ID "shard"
+
+namespace dePhonica::Core::Api {
+
+// Shard side of the distributed search - compares peaks received from an API node against the local index.
+// Runs on the engine's deferred handler threads, one search per request, on the pooled searches the
+// sessions of this node use, admitted by the same scheduler.
+class ShardApiModel
+{
+private:
+    SessionServices& services_;
+
+public:
+    ShardApiModel(SessionServices& services)
+        : services_(services)
+    {
+    }
+
+    QJsonObject Search(const QByteArray& peaksBody, qint64 deadlineMilliseconds)
+    {
+        auto fragmentPeaks = ShardProtocol::DecodePeaks(peaksBody);
+
+        auto deadline = deadlineMilliseconds > 0 ? QDeadlineTimer(deadlineMilliseconds) : QDeadlineTimer(QDeadlineTimer::Forever);
+
+        std::vector<LutResult> searchResult;
+        CatchHistogram catchHistogram;
+        bool isPartialResult = false;
+
+        {
+            SearchSlot searchSlot(services_.Scheduler, deadline, SHARD_CLIENT_ID);
+
+            // The requesting node no longer waits for a search admitted after its deadline
+            isPartialResult = deadline.hasExpired();
+
+            if (isPartialResult == false)
+            {
+                CatalogueSearchLease catalogueSearch(services_.CatalogueSearches, services_.Topology.NextNode());
+                catalogueSearch->Search(fragmentPeaks, searchResult, &catchHistogram);
+            }
+        }
+
+        return { { "tracks", ShardProtocol::EncodeResult(searchResult) },
+                 { "catches", ShardProtocol::EncodeHistogram(catchHistogram) },
+                 { "isPartialResult", isPartialResult },
+                 { "result", "ok" } };
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHARDAPIMODEL_H
@@ -0,0 +1,61 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHARDAPIVIEW_H
+#define SHARDAPIVIEW_H
+
+#include <QJsonObject>
+
+#include "CoreException.h"
+#include "API/IBaseApiView.h"
+#include "API/Shards/ShardApiModel.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+using namespace dePhonica::Core::Interfaces;
+
+class ShardApiView : public IBaseApiView
+{
+private:
+    ShardApiModel shardModel_;
+
+public:
+    ShardApiView(SessionServices& services)
+        : shardModel_(services)
+    {
+    }
+
+    QString Name() override { return "ShardApiView"; }
+    QStringList Endpoints() override { return { "shard/search" }; }
+
+    QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::Post; }
+
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+
+    QJsonObject Post(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+
+    // A search blocks for up to its deadline, so it runs off the event loop thread
+    DeferredHandler PostDeferred(const QHttpServerRequest& request, const RouteArguments&) override
+    {
+        bool ok = false;
+        qint64 deadlineMilliseconds = request.value(SHARD_DEADLINE_HEADER).toLongLong(&ok);
+
+        return [this, peaksBody = request.body(), deadlineMilliseconds = ok ? deadlineMilliseconds : 0]() {
+            return shardModel_.Search(peaksBody, deadlineMilliseconds);
+        };
+    }
+
+    QJsonObject Put(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHARDAPIVIEW_H
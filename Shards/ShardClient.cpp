@@ -0,0 +1,225 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include "ShardClient.h"
+
+#include <algorithm>
+#include <functional>
+
+#include <QDebug>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+#include "API/Search/CatalogueSearch.h"
+#include "API/Search/TopTracks.h"
+#include "API/Shards/ShardProtocol.h"
+
+namespace dePhonica::Core::Api {
+
+ShardClient::ShardClient(const ShardSettings& settings)
+    : settings_(settings)
+{
+}
+
+ShardClient::~ShardClient()
+{
+}
+
+size_t ShardClient::Search(const std::vector<PeakDescription>& fragmentPeaks,
+                           const QDeadlineTimer& deadline,
+                           std::vector<LutResult>& searchResult,
+                           CatchHistogram* catchHistogram)
+{
+    if (networkManager_ == nullptr)
+    {
+        networkManager_ = std::make_unique<QNetworkAccessManager>();
+    }
+
+    struct ShardState
+    {
+        int NextReplica = 0;
+        std::vector<QNetworkReply*> Requests;
+
+        bool IsDone = false;
+        bool IsAnswered = false;
+        bool IsPartialResult = false;
+        std::vector<LutResult> SearchResult;
+        CatchHistogram Catches;
+    };
+
+    std::vector<ShardState> shards(settings_.Shards.size());
+    std::vector<QNetworkReply*> replies;
+    size_t shardsPending = shards.size();
+
+    QDeadlineTimer timeout(settings_.TimeoutMilliseconds);
+    if (deadline.isForever() == false && deadline < timeout)
+    {
+        timeout = deadline;
+    }
+
+    auto body = ShardProtocol::EncodePeaks(fragmentPeaks);
+
+    QEventLoop loop;
+
+    std::function<bool(size_t)> sendRequest;
+    std::function<void(size_t, QNetworkReply*)> onFinished;
+
+    auto completeShard = [&](ShardState& shard) {
+        shard.IsDone = true;
+
+        // Aborting emits finished synchronously, the handler ignores replies of completed shards
+        auto requests = shard.Requests;
+        shard.Requests.clear();
+
+        for (auto request : requests)
+        {
+            request->abort();
+        }
+
+        if (--shardsPending == 0)
+        {
+            loop.quit();
+        }
+    };
+
+    sendRequest = [&](size_t shardIndex) {
+        auto& shard = shards[shardIndex];
+        const auto& replicas = settings_.Shards[shardIndex];
+
+        if (shard.NextReplica >= replicas.size())
+        {
+            return false;
+        }
+
+        QNetworkRequest request(QUrl(replicas[shard.NextReplica++] + "/shard/search"));
+        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+        request.setRawHeader(SHARD_DEADLINE_HEADER, QByteArray::number(std::max<qint64>(1, timeout.remainingTime())));
+
+        auto reply = networkManager_->post(request, body);
+        shard.Requests.push_back(reply);
+        replies.push_back(reply);
+
+        QObject::connect(reply, &QNetworkReply::finished, &loop, [&onFinished, shardIndex, reply]() { onFinished(shardIndex, reply); });
+
+        return true;
+    };
+
+    onFinished = [&](size_t shardIndex, QNetworkReply* reply) {
+        auto& shard = shards[shardIndex];
+        shard.Requests.erase(std::remove(shard.Requests.begin(), shard.Requests.end(), reply), shard.Requests.end());
+
+        if (shard.IsDone)
+        {
+            return;
+        }
+
+        if (reply->error() == QNetworkReply::NoError)
+        {
+            auto response = QJsonDocument::fromJson(reply->readAll()).object();
+
+            if (response["result"].toString() == "ok")
+            {
+                shard.SearchResult = ShardProtocol::DecodeResult(response["tracks"].toArray());
+                ShardProtocol::DecodeHistogram(response["catches"].toArray(), shard.Catches);
+                shard.IsPartialResult = response["isPartialResult"].toBool();
+                shard.IsAnswered = true;
+
+                completeShard(shard);
+                return;
+            }
+        }
+
+        qInfo() << QString("Shard %1 request failed: %2").arg(shardIndex).arg(reply->errorString());
+
+        // Fail over to the next replica unless a hedged request to this shard is still running
+        if (shard.Requests.empty() && sendRequest(shardIndex) == false)
+        {
+            completeShard(shard);
+        }
+    };
+
+    for (size_t n = 0; n < shards.size(); n++)
+    {
+        sendRequest(n);
+    }
+
+    QTimer hedgeTimer;
+    hedgeTimer.setSingleShot(true);
+    QObject::connect(&hedgeTimer, &QTimer::timeout, &loop, [&]() {
+        for (size_t n = 0; n < shards.size(); n++)
+        {
+            if (shards[n].IsDone == false && shards[n].Requests.size() == 1)
+            {
+                sendRequest(n);
+            }
+        }
+    });
+
+    QTimer timeoutTimer;
+    timeoutTimer.setSingleShot(true);
+    QObject::connect(&timeoutTimer, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    if (shardsPending > 0)
+    {
+        if (settings_.HedgeDelayMilliseconds > 0)
+        {
+            hedgeTimer.start(settings_.HedgeDelayMilliseconds);
+        }
+
+        timeoutTimer.start(static_cast<int>(std::max<qint64>(0, timeout.remainingTime())));
+        loop.exec();
+    }
+
+    for (auto& shard : shards)
+    {
+        shard.IsDone = true;
+    }
+
+    // Handlers reference this frame, so no reply may outlive it
+    for (auto reply : replies)
+    {
+        QObject::disconnect(reply, nullptr, &loop, nullptr);
+        reply->abort();
+        delete reply;
+    }
+
+    size_t shardsIncomplete = 0;
+    std::vector<std::vector<LutResult>> partialResults;
+
+    if (catchHistogram != nullptr)
+    {
+        catchHistogram->clear();
+    }
+
+    for (auto& shard : shards)
+    {
+        if (shard.IsAnswered == false || shard.IsPartialResult)
+        {
+            shardsIncomplete++;
+        }
+
+        if (catchHistogram != nullptr)
+        {
+            TopTracks::AddHistogram(shard.Catches, *catchHistogram);
+        }
+
+        partialResults.push_back(std::move(shard.SearchResult));
+    }
+
+    TopTracks::Merge(partialResults, SEARCH_TOP_TRACKS, searchResult);
+
+    return shardsIncomplete;
+}
+
+} // namespace dePhonica::Core::Api
@@ -0,0 +1,52 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHARDCLIENT_H
+#define SHARDCLIENT_H
+
+#include <memory>
+#include <vector>
+
+#include <QDeadlineTimer>
+#include <QNetworkAccessManager>
+
+#include "API/Search/TopTracks.h"
+#include "API/Shards/ShardSettings.h"
+#include "Engine/Fingerprinter.h"
+#include "Engine/SearchHashesWorker.h"
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::MusicSearch;
+
+// API node side of the distributed search. Scatters fragment peaks to every shard, hedges slow shards
+// to their next replica, fails over on errors and gathers the partial top-K lists into one result.
+// Lives in the thread which calls Search - the network manager is created there.
+class ShardClient
+{
+private:
+    const ShardSettings& settings_;
+
+    std::unique_ptr<QNetworkAccessManager> networkManager_;
+
+public:
+    ShardClient(const ShardSettings& settings);
+    ~ShardClient();
+
+    // Returns the number of shards which gave no or only a partial answer before the timeout. The histogram, if
+    // given, is cleared and sums the catch histograms of the answering shards.
+    size_t Search(const std::vector<PeakDescription>& fragmentPeaks,
+                  const QDeadlineTimer& deadline,
+                  std::vector<LutResult>& searchResult,
+                  CatchHistogram* catchHistogram = nullptr);
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHARDCLIENT_H
@@ -0,0 +1,163 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHARDPROTOCOL_H
+#define SHARDPROTOCOL_H
+
+#include <vector>
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include "CoreException.h"
+#include "API/Search/TopTracks.h"
+#include "Engine/Fingerprinter.h"
+#include "Engine/SearchHashesWorker.h"
+
+#define SHARD_PROTOCOL_MAGIC 0x64505348
+#define SHARD_DEADLINE_HEADER "X-Search-Deadline-Ms"
+// Largest catch count a shard histogram may carry
+#define SHARD_MAX_CATCHES 1000000
+
+namespace dePhonica::Core::Api {
+
+using namespace dePhonica::Core;
+using namespace dePhonica::MusicSearch;
+
+// Wire format between the API node and shard nodes. Fragment peaks travel as a compact binary body,
+// partial results come back as [trackIndex, chunkIndex, catches] triplets in the JSON response, with the
+// catch histogram of all matched tracks of the shard as [catches, tracksCount] pairs of its non-zero counts.
+class ShardProtocol
+{
+public:
+    static QByteArray EncodePeaks(const std::vector<PeakDescription>& peaks)
+    {
+        QByteArray body;
+        QDataStream stream(&body, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+        stream << static_cast<quint32>(SHARD_PROTOCOL_MAGIC) << static_cast<quint32>(peaks.size());
+
+        for (const auto& peak : peaks)
+        {
+            stream << static_cast<quint32>(peak.BandIndex) << static_cast<quint32>(peak.ChunkIndex) << static_cast<float>(peak.PeakCutoffDb);
+        }
+
+        return body;
+    }
+
+    static std::vector<PeakDescription> DecodePeaks(const QByteArray& body)
+    {
+        QDataStream stream(body);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+        quint32 magic = 0, peaksCount = 0;
+        stream >> magic >> peaksCount;
+
+        if (magic != SHARD_PROTOCOL_MAGIC || static_cast<size_t>(body.size()) < 8 + static_cast<size_t>(peaksCount) * 12)
+        {
+            throw CoreException("Invalid shard search request - malformed peaks body");
+        }
+
+        std::vector<PeakDescription> peaks(peaksCount);
+
+        for (auto& peak : peaks)
+        {
+            quint32 bandIndex, chunkIndex;
+            float peakCutoffDb;
+            stream >> bandIndex >> chunkIndex >> peakCutoffDb;
+
+            peak.BandIndex = bandIndex;
+            peak.ChunkIndex = chunkIndex;
+            peak.PeakCutoffDb = peakCutoffDb;
+        }
+
+        return peaks;
+    }
+
+    static QJsonArray EncodeResult(const std::vector<LutResult>& searchResult)
+    {
+        QJsonArray tracks;
+
+        for (const auto& result : searchResult)
+        {
+            tracks.append(QJsonArray(
+                { static_cast<qint64>(result.TrackIndex), static_cast<qint64>(result.ChunkIndex), static_cast<qint64>(result.Catches) }));
+        }
+
+        return tracks;
+    }
+
+    static std::vector<LutResult> DecodeResult(const QJsonArray& tracks)
+    {
+        std::vector<LutResult> searchResult;
+        searchResult.reserve(tracks.size());
+
+        for (const auto& track : tracks)
+        {
+            auto fields = track.toArray();
+
+            LutResult result;
+            result.TrackIndex = static_cast<decltype(result.TrackIndex)>(fields[0].toDouble());
+            result.ChunkIndex = static_cast<decltype(result.ChunkIndex)>(fields[1].toDouble());
+            result.Catches = static_cast<decltype(result.Catches)>(fields[2].toDouble());
+
+            searchResult.push_back(result);
+        }
+
+        return searchResult;
+    }
+
+    static QJsonArray EncodeHistogram(const CatchHistogram& catchHistogram)
+    {
+        QJsonArray counts;
+
+        for (size_t catches = 0; catches < catchHistogram.size(); catches++)
+        {
+            if (catchHistogram[catches] > 0)
+            {
+                counts.append(QJsonArray({ static_cast<qint64>(catches), static_cast<qint64>(catchHistogram[catches]) }));
+            }
+        }
+
+        return counts;
+    }
+
+    static void DecodeHistogram(const QJsonArray& counts, CatchHistogram& catchHistogram)
+    {
+        catchHistogram.clear();
+
+        for (const auto& count : counts)
+        {
+            auto fields = count.toArray();
+            auto catches = fields[0].toDouble(-1);
+
+            // Catch counts are bounded by the fragment peaks, a larger one is a malformed answer
+            if (catches < 0 || catches > SHARD_MAX_CATCHES)
+            {
+                continue;
+            }
+
+            if (static_cast<size_t>(catches) >= catchHistogram.size())
+            {
+                catchHistogram.resize(static_cast<size_t>(catches) + 1);
+            }
+
+            catchHistogram[static_cast<size_t>(catches)] += static_cast<uint32_t>(fields[1].toDouble());
+        }
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHARDPROTOCOL_H
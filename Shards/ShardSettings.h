@@ -0,0 +1,80 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#ifndef SHARDSETTINGS_H
+#define SHARDSETTINGS_H
+
+#include <vector>
+
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+
+#define SHARD_TIMEOUT_MILLISECONDS 2000
+#define SHARD_HEDGE_DELAY_MILLISECONDS 200
+
+namespace dePhonica::Core::Api {
+
+// Index shards queried by this node instead of the local index. Every shard holds a partition of the
+// catalogue indexed with the global track numbering and may be served by several replicas.
+struct ShardSettings
+{
+    // Base URIs of every shard's replicas, e.g. "http://127.0.0.1:8081/api"
+    std::vector<QStringList> Shards;
+
+    int TimeoutMilliseconds = SHARD_TIMEOUT_MILLISECONDS;
+
+    // A shard which has not answered within the delay gets the same request sent to its next replica
+    int HedgeDelayMilliseconds = SHARD_HEDGE_DELAY_MILLISECONDS;
+
+    bool IsEnabled() const { return Shards.empty() == false; }
+
+    // Shards are separated by ',' and replicas of a shard by '|'
+    static ShardSettings Parse(const QString& shardsDefinition)
+    {
+        ShardSettings settings;
+
+        for (const auto& shard : shardsDefinition.split(',', QString::SkipEmptyParts))
+        {
+            auto replicas = shard.trimmed().split('|', QString::SkipEmptyParts);
+            for (auto& replica : replicas)
+            {
+                replica = replica.trimmed();
+                if (replica.endsWith('/'))
+                {
+                    replica.chop(1);
+                }
+            }
+
+            if (replicas.isEmpty() == false)
+            {
+                settings.Shards.push_back(replicas);
+            }
+        }
+
+        return settings;
+    }
+
+    // Reads SEARCH_SHARDS, SEARCH_SHARD_TIMEOUT_MS and SEARCH_SHARD_HEDGE_MS
+    static ShardSettings FromEnvironment()
+    {
+        auto environment = QProcessEnvironment::systemEnvironment();
+
+        auto settings = Parse(environment.value("SEARCH_SHARDS"));
+        settings.TimeoutMilliseconds = environment.value("SEARCH_SHARD_TIMEOUT_MS", QString::number(SHARD_TIMEOUT_MILLISECONDS)).toInt();
+        settings.HedgeDelayMilliseconds =
+            environment.value("SEARCH_SHARD_HEDGE_MS", QString::number(SHARD_HEDGE_DELAY_MILLISECONDS)).toInt();
+
+        return settings;
+    }
+};
+
+} // namespace dePhonica::Core::Api
+
+#endif // SHARDSETTINGS_H
@@ -0,0 +1,151 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <QtTest>
+
+#include "API/Session/SampleChunkList.h"
+
+#define TEST_CHUNK_SAMPLES 100
+
+using namespace dePhonica::Core::Api;
+
+class SampleChunkListTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static std::vector<float> Ramp(size_t count, float from = 0)
+    {
+        std::vector<float> samples(count);
+        std::iota(samples.begin(), samples.end(), from);
+        return samples;
+    }
+
+    static std::vector<float> Read(SampleChunkList& chunkList)
+    {
+        SampleView view;
+        chunkList.View(view);
+
+        std::vector<float> samples(view.Length());
+        view.CopyTo(samples.data(), 0, samples.size());
+        return samples;
+    }
+
+private slots:
+    void AppendsAcrossChunks()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        auto samples = Ramp(250);
+
+        chunkList.Append(samples.data(), 30);
+        chunkList.Append(samples.data() + 30, 220);
+
+        QCOMPARE(chunkList.Length(), samples.size());
+        QCOMPARE(chunkList.AllocatedBytes(), static_cast<size_t>(3 * TEST_CHUNK_SAMPLES * sizeof(float)));
+        QVERIFY(Read(chunkList) == samples);
+    }
+
+    void AppendsInPlace()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        auto samples = Ramp(190);
+
+        // The first append fits the chunk and is written in place, the second crosses into the next chunk
+        for (size_t offset : { 0, 80 })
+        {
+            size_t count = offset == 0 ? 80 : 110;
+
+            auto storage = chunkList.PrepareAppend(count + 10);
+            std::copy(samples.begin() + offset, samples.begin() + offset + count, storage);
+
+            auto committed = chunkList.CommitAppend(count);
+            QVERIFY(std::equal(committed, committed + count, samples.begin() + offset));
+        }
+
+        QVERIFY(Read(chunkList) == samples);
+    }
+
+    void ViewKeepsItsLength()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        auto samples = Ramp(300);
+        chunkList.Append(samples.data(), 150);
+
+        SampleView view;
+        chunkList.View(view);
+
+        chunkList.Append(samples.data() + 150, 150);
+
+        QCOMPARE(view.Length(), static_cast<size_t>(150));
+
+        std::vector<float> viewed(200, -1.0f);
+        view.CopyTo(viewed.data(), 100, 100);
+
+        QVERIFY(std::equal(viewed.begin(), viewed.begin() + 50, samples.begin() + 100));
+        QVERIFY(viewed[50] == -1.0f);
+    }
+
+    void ContiguousPointsIntoChunks()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        auto samples = Ramp(200);
+        chunkList.Append(samples.data(), samples.size());
+
+        SampleView view;
+        chunkList.View(view);
+
+        auto inside = view.Contiguous(110, 50);
+        auto across = view.Contiguous(90, 20);
+
+        QVERIFY(std::equal(inside, inside + 50, samples.begin() + 110));
+        QVERIFY(std::equal(across, across + 20, samples.begin() + 90));
+        QVERIFY(view.Contiguous(120, 10) == inside + 10);
+    }
+
+    void ReserveAheadAddsNextChunk()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        chunkList.Reserve();
+
+        auto samples = Ramp(60);
+        chunkList.Append(samples.data(), samples.size());
+
+        chunkList.ReserveAhead(30);
+        QCOMPARE(chunkList.AllocatedBytes(), static_cast<size_t>(TEST_CHUNK_SAMPLES * sizeof(float)));
+
+        chunkList.ReserveAhead(50);
+        QCOMPARE(chunkList.AllocatedBytes(), static_cast<size_t>(2 * TEST_CHUNK_SAMPLES * sizeof(float)));
+
+        chunkList.Append(samples.data(), samples.size());
+        QCOMPARE(chunkList.AllocatedBytes(), static_cast<size_t>(2 * TEST_CHUNK_SAMPLES * sizeof(float)));
+    }
+
+    void ResetKeepsFirstChunk()
+    {
+        SampleChunkList chunkList(TEST_CHUNK_SAMPLES);
+        auto samples = Ramp(250);
+        chunkList.Append(samples.data(), samples.size());
+
+        chunkList.Reset();
+
+        QCOMPARE(chunkList.Length(), static_cast<size_t>(0));
+        QCOMPARE(chunkList.AllocatedBytes(), static_cast<size_t>(TEST_CHUNK_SAMPLES * sizeof(float)));
+
+        chunkList.Append(samples.data() + 10, 20);
+        QVERIFY(Read(chunkList) == std::vector<float>(samples.begin() + 10, samples.begin() + 30));
+    }
+};
+
+QTEST_APPLESS_MAIN(SampleChunkListTest)
+
+#include "SampleChunkListTest.moc"
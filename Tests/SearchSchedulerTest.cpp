@@ -0,0 +1,151 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QtTest>
+
+#include "API/Search/SearchScheduler.h"
+
+using namespace dePhonica::Core::Api;
+
+class SearchSchedulerTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Searches queued one after another behind a slot held by the test, granted in the scheduler's order
+    struct QueuedSearches
+    {
+        SearchScheduler& Scheduler;
+
+        std::mutex GrantedLock;
+        std::vector<QString> Granted;
+        std::vector<std::thread> Threads;
+
+        void Queue(const QString& clientId, const QString& label, const QDeadlineTimer& deadline)
+        {
+            auto pendingCount = Scheduler.PendingCount();
+
+            Threads.emplace_back([this, clientId, label, deadline]() {
+                SearchSlot slot(Scheduler, deadline, clientId);
+
+                std::lock_guard<std::mutex> locker(GrantedLock);
+                Granted.push_back(label);
+            });
+
+            while (Scheduler.PendingCount() == pendingCount)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        void Join()
+        {
+            for (auto& thread : Threads)
+            {
+                thread.join();
+            }
+        }
+    };
+
+private slots:
+    void LimitsRunningSearches()
+    {
+        SearchScheduler scheduler(2);
+
+        std::atomic<int> running { 0 }, maxRunning { 0 };
+        std::vector<std::thread> threads;
+
+        for (int n = 0; n < 8; n++)
+        {
+            threads.emplace_back([&scheduler, &running, &maxRunning, n]() {
+                SearchSlot slot(scheduler, QDeadlineTimer(QDeadlineTimer::Forever), n % 2 == 0 ? "even" : "odd");
+
+                auto nowRunning = ++running;
+                auto previousMax = maxRunning.load();
+                while (nowRunning > previousMax && maxRunning.compare_exchange_weak(previousMax, nowRunning) == false)
+                {
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                running--;
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        QVERIFY(maxRunning.load() >= 1 && maxRunning.load() <= 2);
+        QCOMPARE(scheduler.PendingCount(), static_cast<size_t>(0));
+    }
+
+    void GrantsOwnSearchesByDeadline()
+    {
+        SearchScheduler scheduler(1);
+        scheduler.Acquire(QDeadlineTimer(QDeadlineTimer::Forever), "holder");
+
+        QueuedSearches searches { scheduler };
+        searches.Queue("client", "forever", QDeadlineTimer(QDeadlineTimer::Forever));
+        searches.Queue("client", "late", QDeadlineTimer(60000));
+        searches.Queue("client", "early", QDeadlineTimer(30000));
+
+        scheduler.Release("holder", 10);
+        searches.Join();
+
+        QVERIFY(searches.Granted == std::vector<QString>({ "early", "late", "forever" }));
+    }
+
+    void SharesSlotsBetweenClients()
+    {
+        SearchScheduler scheduler(1);
+        scheduler.Acquire(QDeadlineTimer(QDeadlineTimer::Forever), "holder");
+
+        QueuedSearches searches { scheduler };
+        searches.Queue("heavy", "heavy", QDeadlineTimer(QDeadlineTimer::Forever));
+        searches.Queue("heavy", "heavy", QDeadlineTimer(QDeadlineTimer::Forever));
+        searches.Queue("heavy", "heavy", QDeadlineTimer(QDeadlineTimer::Forever));
+        searches.Queue("light", "light", QDeadlineTimer(QDeadlineTimer::Forever));
+
+        scheduler.Release("holder", 10);
+        searches.Join();
+
+        // The search queued last does not wait behind all searches of the busier client
+        QVERIFY(searches.Granted == std::vector<QString>({ "heavy", "light", "heavy", "heavy" }));
+    }
+
+    void DeadlinesDoNotReorderClients()
+    {
+        SearchScheduler scheduler(1);
+        scheduler.Acquire(QDeadlineTimer(QDeadlineTimer::Forever), "holder");
+
+        QueuedSearches searches { scheduler };
+        searches.Queue("interactive", "urgent", QDeadlineTimer(10000));
+        searches.Queue("batch", "batch", QDeadlineTimer(QDeadlineTimer::Forever));
+        searches.Queue("interactive", "less urgent", QDeadlineTimer(20000));
+
+        scheduler.Release("holder", 10);
+        searches.Join();
+
+        // Equal virtual times go to the earlier deadline, afterwards the fair share decides even though the
+        // second interactive search is due before the batch one
+        QVERIFY(searches.Granted == std::vector<QString>({ "urgent", "batch", "less urgent" }));
+    }
+};
+
+QTEST_APPLESS_MAIN(SearchSchedulerTest)
+
+#include "SearchSchedulerTest.moc"
@@ -0,0 +1,181 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+
+#include "API/Session/SessionRecorder.h"
+
+#define TEST_SAMPLE_RATE 16000
+#define TEST_TAIL_SAMPLES 1000
+
+using namespace dePhonica::Core::Api;
+
+class SessionRecorderTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    struct Record
+    {
+        qint64 Offset;
+        SessionRecording::RecordType Type;
+        SessionRecording::RecordCodec Codec;
+        quint64 FirstSample;
+        QByteArray Payload;
+    };
+
+    static QByteArray Unshuffle(const QByteArray& shuffled)
+    {
+        auto count = static_cast<size_t>(shuffled.size()) / sizeof(float);
+        QByteArray floats(shuffled.size(), Qt::Uninitialized);
+
+        for (size_t byte = 0; byte < sizeof(float); byte++)
+        {
+            for (size_t n = 0; n < count; n++)
+            {
+                floats[static_cast<int>(n * sizeof(float) + byte)] = shuffled[static_cast<int>(byte * count + n)];
+            }
+        }
+
+        return floats;
+    }
+
+    static QByteArray Decode(SessionRecording::RecordCodec codec, const QByteArray& stored, quint32 rawBytes)
+    {
+        if (codec == SessionRecording::RecordCodec::Raw)
+        {
+            return stored;
+        }
+
+        // The record header holds the raw size that qUncompress expects in front of the zlib stream
+        QByteArray prefixed(4, '\0');
+        qToBigEndian<quint32>(rawBytes, prefixed.data());
+        auto payload = qUncompress(prefixed + stored);
+
+        return codec == SessionRecording::RecordCodec::ShuffledZlib ? Unshuffle(payload) : payload;
+    }
+
+    static std::vector<Record> ReadRecords(const QByteArray& fileData)
+    {
+        std::vector<Record> records;
+        qint64 offset = SESSION_RECORDING_HEADER_BYTES;
+
+        while (offset + SESSION_RECORDING_RECORD_HEADER_BYTES <= fileData.size())
+        {
+            auto header = fileData.constData() + offset;
+            auto storedBytes = qFromLittleEndian<quint32>(header + 16);
+            auto rawBytes = qFromLittleEndian<quint32>(header + 20);
+
+            Record record;
+            record.Offset = offset;
+            record.Type = static_cast<SessionRecording::RecordType>(qFromLittleEndian<quint32>(header));
+            record.Codec = static_cast<SessionRecording::RecordCodec>(qFromLittleEndian<quint32>(header + 4));
+            record.FirstSample = qFromLittleEndian<quint64>(header + 8);
+            record.Payload = Decode(record.Codec, fileData.mid(static_cast<int>(offset) + SESSION_RECORDING_RECORD_HEADER_BYTES, storedBytes), rawBytes);
+            records.push_back(record);
+
+            auto paddedBytes = (storedBytes + SESSION_RECORDING_ALIGNMENT - 1) / SESSION_RECORDING_ALIGNMENT * SESSION_RECORDING_ALIGNMENT;
+            offset += SESSION_RECORDING_RECORD_HEADER_BYTES + paddedBytes;
+        }
+
+        return records;
+    }
+
+private slots:
+    void DisabledRecorderOpensNothing()
+    {
+        SessionRecorder recorder(RecorderSettings { 0, QString() });
+
+        QVERIFY(recorder.Open(QJsonObject(), TEST_SAMPLE_RATE) == nullptr);
+    }
+
+    void WritesRecordLayout()
+    {
+        QTemporaryDir directory;
+        QVERIFY(directory.isValid());
+
+        std::vector<float> samples(SESSION_RECORD_CHUNK_SAMPLES + TEST_TAIL_SAMPLES);
+        std::iota(samples.begin(), samples.end(), 0.0f);
+
+        QJsonObject sessionInfo { { "token", "recorder-test" } };
+        QString path;
+
+        {
+            // The recorder writes everything queued before its destructor returns
+            SessionRecorder recorder(RecorderSettings { 1, directory.path() });
+
+            auto recording = recorder.Open(sessionInfo, TEST_SAMPLE_RATE);
+            QVERIFY(recording != nullptr);
+            path = recording->Path();
+
+            for (size_t offset = 0; offset < samples.size(); offset += TEST_SAMPLE_RATE)
+            {
+                recorder.Append(recording, samples.data() + offset, std::min<size_t>(TEST_SAMPLE_RATE, samples.size() - offset));
+            }
+
+            recorder.Close(recording, "session log");
+        }
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        auto fileData = file.readAll();
+
+        QVERIFY(fileData.size() >= SESSION_RECORDING_HEADER_BYTES);
+        QCOMPARE(qFromLittleEndian<quint32>(fileData.constData()), static_cast<quint32>(SESSION_RECORDING_MAGIC));
+        QCOMPARE(qFromLittleEndian<quint32>(fileData.constData() + 4), static_cast<quint32>(SESSION_RECORDING_VERSION));
+        QCOMPARE(qFromLittleEndian<quint32>(fileData.constData() + 8), static_cast<quint32>(TEST_SAMPLE_RATE));
+        QCOMPARE(qFromLittleEndian<quint32>(fileData.constData() + 12), static_cast<quint32>(1));
+        QCOMPARE(qFromLittleEndian<quint64>(fileData.constData() + 24), static_cast<quint64>(0));
+
+        auto records = ReadRecords(fileData);
+        QCOMPARE(records.size(), static_cast<size_t>(5));
+
+        for (const auto& record : records)
+        {
+            QCOMPARE(record.Offset % SESSION_RECORDING_ALIGNMENT, static_cast<qint64>(0));
+        }
+
+        QVERIFY(records[0].Type == SessionRecording::RecordType::SessionInfo);
+        QCOMPARE(QJsonDocument::fromJson(records[0].Payload).object(), sessionInfo);
+
+        // A full chunk once enough samples are pending, the tail when the recording is closed
+        QVERIFY(records[1].Type == SessionRecording::RecordType::Samples);
+        QVERIFY(records[1].Codec == SessionRecording::RecordCodec::ShuffledZlib);
+        QCOMPARE(records[1].FirstSample, static_cast<quint64>(0));
+
+        QVERIFY(records[2].Type == SessionRecording::RecordType::Samples);
+        QCOMPARE(records[2].FirstSample, static_cast<quint64>(records[1].Payload.size() / sizeof(float)));
+
+        auto recorded = records[1].Payload + records[2].Payload;
+        QCOMPARE(static_cast<size_t>(recorded.size()), samples.size() * sizeof(float));
+        QVERIFY(std::memcmp(recorded.constData(), samples.data(), recorded.size()) == 0);
+
+        QVERIFY(records[3].Type == SessionRecording::RecordType::Log);
+        QCOMPARE(QString::fromUtf8(records[3].Payload), QString("session log"));
+        QCOMPARE(records[3].FirstSample, static_cast<quint64>(samples.size()));
+
+        QVERIFY(records[4].Type == SessionRecording::RecordType::End);
+        QVERIFY(records[4].Payload.isEmpty());
+        QCOMPARE(records[4].Offset + SESSION_RECORDING_RECORD_HEADER_BYTES, static_cast<qint64>(fileData.size()));
+    }
+};
+
+QTEST_APPLESS_MAIN(SessionRecorderTest)
+
+#include "SessionRecorderTest.moc"
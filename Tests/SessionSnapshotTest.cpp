@@ -0,0 +1,156 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <limits>
+#include <numeric>
+
+#include <QtEndian>
+#include <QtTest>
+
+#include "CoreException.h"
+#include "API/Session/SessionSnapshot.h"
+
+using namespace dePhonica::Core;
+using namespace dePhonica::Core::Api;
+
+class SessionSnapshotTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static PeakDescription Peak(size_t bandIndex, size_t chunkIndex)
+    {
+        PeakDescription peak;
+        peak.BandIndex = bandIndex;
+        peak.ChunkIndex = chunkIndex;
+        peak.PeakCutoffDb = -30.0f;
+        return peak;
+    }
+
+    static LutResult Result(size_t trackIndex, size_t chunkIndex, size_t catches)
+    {
+        LutResult result;
+        result.TrackIndex = static_cast<decltype(result.TrackIndex)>(trackIndex);
+        result.ChunkIndex = static_cast<decltype(result.ChunkIndex)>(chunkIndex);
+        result.Catches = static_cast<decltype(result.Catches)>(catches);
+        return result;
+    }
+
+    static SessionSnapshot Snapshot()
+    {
+        SessionSnapshot snapshot;
+        snapshot.SessionInfo = { { "token", "snapshot-test" }, { "sampleRate", 16000 } };
+
+        snapshot.Samples.resize(16000);
+        std::iota(snapshot.Samples.begin(), snapshot.Samples.end(), -8000.0f);
+
+        snapshot.FragmentPeaks = { Peak(1, 0), Peak(7, 3), Peak(2, 12) };
+        snapshot.SearchResult = { Result(5, 120, 40), Result(0, 7, 12) };
+        snapshot.ResultVersion = 17;
+        snapshot.MaxResultDelta = 0.75f;
+        snapshot.SqAverageDelta = 0.125f;
+        snapshot.IsPartialResult = true;
+
+        return snapshot;
+    }
+
+private slots:
+    void RoundTrip()
+    {
+        auto snapshot = Snapshot();
+        auto restored = SessionSnapshot::Deserialize(snapshot.Serialize());
+
+        QCOMPARE(restored.SessionInfo, snapshot.SessionInfo);
+        QVERIFY(restored.Samples == snapshot.Samples);
+
+        QCOMPARE(restored.FragmentPeaks.size(), snapshot.FragmentPeaks.size());
+        for (size_t n = 0; n < snapshot.FragmentPeaks.size(); n++)
+        {
+            QVERIFY(restored.FragmentPeaks[n].BandIndex == snapshot.FragmentPeaks[n].BandIndex);
+            QVERIFY(restored.FragmentPeaks[n].ChunkIndex == snapshot.FragmentPeaks[n].ChunkIndex);
+            QVERIFY(restored.FragmentPeaks[n].PeakCutoffDb == snapshot.FragmentPeaks[n].PeakCutoffDb);
+        }
+
+        QCOMPARE(restored.SearchResult.size(), snapshot.SearchResult.size());
+        for (size_t n = 0; n < snapshot.SearchResult.size(); n++)
+        {
+            QVERIFY(restored.SearchResult[n].TrackIndex == snapshot.SearchResult[n].TrackIndex);
+            QVERIFY(restored.SearchResult[n].ChunkIndex == snapshot.SearchResult[n].ChunkIndex);
+            QVERIFY(restored.SearchResult[n].Catches == snapshot.SearchResult[n].Catches);
+        }
+
+        QCOMPARE(restored.ResultVersion, snapshot.ResultVersion);
+        QCOMPARE(restored.MaxResultDelta, snapshot.MaxResultDelta);
+        QCOMPARE(restored.SqAverageDelta, snapshot.SqAverageDelta);
+        QCOMPARE(restored.IsPartialResult, snapshot.IsPartialResult);
+    }
+
+    void RejectsTruncatedData()
+    {
+        auto snapshotData = Snapshot().Serialize();
+
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(QByteArray()), CoreException);
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(snapshotData.left(3)), CoreException);
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(snapshotData.left(snapshotData.size() / 2)), CoreException);
+
+        // A complete zlib stream of a cut snapshot
+        auto rawData = qUncompress(snapshotData);
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(qCompress(rawData.left(rawData.size() - 1))), CoreException);
+    }
+
+    void RejectsCorruptedData()
+    {
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(QByteArray(64, 'x')), CoreException);
+
+        auto rawData = qUncompress(Snapshot().Serialize());
+        rawData[0] = static_cast<char>(rawData[0] ^ 0xff);
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(qCompress(rawData)), CoreException);
+    }
+
+    void RejectsOversizedData()
+    {
+        auto snapshotData = Snapshot().Serialize();
+        qToBigEndian<quint32>(SESSION_SNAPSHOT_MAX_BYTES + 1, snapshotData.data());
+
+        QVERIFY_EXCEPTION_THROWN(SessionSnapshot::Deserialize(snapshotData), CoreException);
+    }
+
+    void ValidateAcceptsInRange()
+    {
+        Snapshot().Validate(MusicSettings(), 10);
+    }
+
+    void ValidateRejectsOutOfRange()
+    {
+        MusicSettings musicSettings;
+
+        auto unknownTrack = Snapshot();
+        unknownTrack.SearchResult.push_back(Result(10, 0, 1));
+        QVERIFY_EXCEPTION_THROWN(unknownTrack.Validate(musicSettings, 10), CoreException);
+
+        auto tooManyResults = Snapshot();
+        QVERIFY_EXCEPTION_THROWN(tooManyResults.Validate(musicSettings, 1), CoreException);
+
+        auto unknownBand = Snapshot();
+        unknownBand.FragmentPeaks.push_back(Peak(static_cast<size_t>(musicSettings.FrequencyPoints), 0));
+        QVERIFY_EXCEPTION_THROWN(unknownBand.Validate(musicSettings, 10), CoreException);
+
+        auto notFinite = Snapshot();
+        notFinite.SqAverageDelta = std::numeric_limits<float>::quiet_NaN();
+        QVERIFY_EXCEPTION_THROWN(notFinite.Validate(musicSettings, 10), CoreException);
+
+        notFinite.SqAverageDelta = 0;
+        notFinite.MaxResultDelta = std::numeric_limits<float>::infinity();
+        QVERIFY_EXCEPTION_THROWN(notFinite.Validate(musicSettings, 10), CoreException);
+    }
+};
+
+QTEST_APPLESS_MAIN(SessionSnapshotTest)
+
+#include "SessionSnapshotTest.moc"
@@ -0,0 +1,169 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <QtTest>
+
+#include "API/Dsp/SignalGate.h"
+
+using namespace dePhonica::Core::Api;
+
+class SignalGateTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static std::vector<float> Tone(size_t count, float frequency = 440.0f, float sampleRate = 16000.0f)
+    {
+        std::vector<float> samples(count);
+        for (size_t n = 0; n < count; n++)
+        {
+            samples[n] = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * frequency * n / sampleRate);
+        }
+
+        return samples;
+    }
+
+    static std::vector<float> Noise(size_t count)
+    {
+        std::mt19937 generator(1);
+        std::normal_distribution<float> noise(0.0f, 0.3f);
+
+        std::vector<float> samples(count);
+        for (auto& sample : samples)
+        {
+            sample = noise(generator);
+        }
+
+        return samples;
+    }
+
+    static float Energy(const std::vector<float>& samples)
+    {
+        float energy = 0;
+        for (auto sample : samples)
+        {
+            energy += sample * sample;
+        }
+
+        return energy;
+    }
+
+private slots:
+    void ZerosAreSilent()
+    {
+        SignalGate gate;
+        std::vector<float> zeros(4 * SIGNAL_GATE_BLOCK_SAMPLES, 0.0f);
+        gate.Push(zeros.data(), zeros.size());
+
+        QCOMPARE(gate.MeasuredSamples(), zeros.size());
+        QCOMPARE(gate.SilentSamples(), zeros.size());
+        QVERIFY(gate.IsSilent(0, zeros.size()));
+        QVERIFY(gate.HasSignal(0, zeros.size()) == false);
+    }
+
+    void ToneHasSignal()
+    {
+        SignalGate gate;
+        auto tone = Tone(4 * SIGNAL_GATE_BLOCK_SAMPLES);
+        gate.Push(tone.data(), tone.size());
+
+        QCOMPARE(gate.SilentSamples(), static_cast<size_t>(0));
+        QVERIFY(gate.HasSignal(0, tone.size()));
+        QVERIFY(gate.IsSilent(0, tone.size()) == false);
+    }
+
+    void WhiteNoiseIsFlat()
+    {
+        auto noise = Noise(SIGNAL_GATE_BLOCK_SAMPLES);
+        auto tone = Tone(SIGNAL_GATE_BLOCK_SAMPLES);
+
+        QVERIFY(SignalGate::SpectralFlatness(noise.data(), noise.size(), Energy(noise)) > SIGNAL_GATE_FLATNESS);
+        QVERIFY(SignalGate::SpectralFlatness(tone.data(), tone.size(), Energy(tone)) < 0.1f);
+
+        SignalGate gate;
+        gate.Push(noise.data(), noise.size());
+        QVERIFY(gate.IsSilent(0, noise.size()));
+    }
+
+    void SplitPushesMatchOnePush()
+    {
+        auto tone = Tone(3 * SIGNAL_GATE_BLOCK_SAMPLES);
+        std::vector<float> samples(2 * SIGNAL_GATE_BLOCK_SAMPLES, 0.0f);
+        samples.insert(samples.end(), tone.begin(), tone.end());
+
+        SignalGate whole, split;
+        whole.Push(samples.data(), samples.size());
+
+        for (size_t offset = 0; offset < samples.size(); offset += 300)
+        {
+            split.Push(samples.data() + offset, std::min<size_t>(300, samples.size() - offset));
+        }
+
+        QCOMPARE(split.MeasuredSamples(), whole.MeasuredSamples());
+        QCOMPARE(split.SilentSamples(), whole.SilentSamples());
+        QCOMPARE(split.SilentSamples(), static_cast<size_t>(2 * SIGNAL_GATE_BLOCK_SAMPLES));
+    }
+
+    void PartialBlockIsMeasured()
+    {
+        SignalGate gate;
+        std::vector<float> zeros(SIGNAL_GATE_BLOCK_SAMPLES, 0.0f);
+        gate.Push(zeros.data(), zeros.size());
+
+        auto tone = Tone(SIGNAL_GATE_BLOCK_SAMPLES / 2);
+        gate.Push(tone.data(), tone.size());
+
+        QCOMPARE(gate.PushedSamples(), zeros.size() + tone.size());
+        QVERIFY(gate.HasSignal(zeros.size(), gate.PushedSamples()));
+        QVERIFY(gate.IsSilent(0, gate.PushedSamples()) == false);
+        QVERIFY(gate.IsSilent(0, zeros.size()));
+    }
+
+    void SilentPartialBlockIsSilent()
+    {
+        SignalGate gate;
+        std::vector<float> zeros(SIGNAL_GATE_BLOCK_SAMPLES + SIGNAL_GATE_BLOCK_SAMPLES / 2, 0.0f);
+        gate.Push(zeros.data(), zeros.size());
+
+        QVERIFY(gate.HasSignal(0, zeros.size()) == false);
+        QVERIFY(gate.IsSilent(0, zeros.size()));
+        QVERIFY(gate.IsSilent(0, zeros.size() + 1) == false);
+    }
+
+    void ShortTailCountsAsSignal()
+    {
+        SignalGate gate;
+        std::vector<float> zeros(SIGNAL_GATE_BLOCK_SAMPLES + SIGNAL_GATE_MIN_PARTIAL_SAMPLES / 2, 0.0f);
+        gate.Push(zeros.data(), zeros.size());
+
+        QVERIFY(gate.HasSignal(SIGNAL_GATE_BLOCK_SAMPLES, zeros.size()));
+        QVERIFY(gate.IsSilent(0, zeros.size()) == false);
+    }
+
+    void ResetForgetsBlocks()
+    {
+        SignalGate gate;
+        std::vector<float> zeros(2 * SIGNAL_GATE_BLOCK_SAMPLES + 10, 0.0f);
+        gate.Push(zeros.data(), zeros.size());
+        gate.Reset();
+
+        QCOMPARE(gate.PushedSamples(), static_cast<size_t>(0));
+        QCOMPARE(gate.SilentSamples(), static_cast<size_t>(0));
+        QVERIFY(gate.IsSilent(0, 1) == false);
+    }
+};
+
+QTEST_APPLESS_MAIN(SignalGateTest)
+
+#include "SignalGateTest.moc"
@@ -0,0 +1,166 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <QtTest>
+
+#include "API/Dsp/StreamResampler.h"
+
+#define TEST_TARGET_RATE 16000
+
+using namespace dePhonica::Core::Api;
+
+class StreamResamplerTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static std::vector<float> Tone(size_t count, double frequency, double sampleRate)
+    {
+        std::vector<float> samples(count);
+        for (size_t n = 0; n < count; n++)
+        {
+            samples[n] = static_cast<float>(0.5 * std::sin(2 * M_PI * frequency * n / sampleRate));
+        }
+
+        return samples;
+    }
+
+    static std::vector<float> Resample(StreamResampler& resampler, const std::vector<float>& input, size_t pieceFrames)
+    {
+        std::vector<float> output;
+
+        for (size_t offset = 0; offset < input.size(); offset += pieceFrames)
+        {
+            auto framesCount = std::min(pieceFrames, input.size() - offset);
+            std::vector<float> piece(resampler.MaxOutputSamples(framesCount));
+
+            auto written = resampler.Process(input.data() + offset, framesCount, piece.data());
+            output.insert(output.end(), piece.begin(), piece.begin() + written);
+        }
+
+        return output;
+    }
+
+    // RMS of the output once the filter history is filled
+    static double SettledRms(const std::vector<float>& samples)
+    {
+        double sum = 0;
+        size_t from = samples.size() / 2;
+
+        for (size_t n = from; n < samples.size(); n++)
+        {
+            sum += static_cast<double>(samples[n]) * samples[n];
+        }
+
+        return std::sqrt(sum / (samples.size() - from));
+    }
+
+private slots:
+    void SupportedRatesMeetStopband()
+    {
+        const size_t supportedRates[] = RESAMPLER_SUPPORTED_RATES;
+
+        for (auto rate : supportedRates)
+        {
+            QVERIFY(StreamResampler::IsSupportedRate(rate));
+
+            StreamResampler resampler;
+            resampler.Configure(rate, TEST_TARGET_RATE, 1);
+
+            if (rate == TEST_TARGET_RATE)
+            {
+                QVERIFY(resampler.Filter() == nullptr);
+                QVERIFY(resampler.IsPassThrough());
+                continue;
+            }
+
+            QVERIFY(resampler.Filter() != nullptr);
+            QVERIFY(resampler.Filter()->MeetsStopband());
+            QVERIFY(resampler.Filter()->TapsPerPhase <= RESAMPLER_MAX_TAPS_PER_PHASE);
+            QCOMPARE(resampler.Filter()->TapsPerPhase % 8, static_cast<size_t>(0));
+        }
+
+        QVERIFY(StreamResampler::IsSupportedRate(12345) == false);
+    }
+
+    void PhasesHaveUnityGain()
+    {
+        // 44100 to 16000 is 160 up, 441 down
+        auto filter = ResamplerFilter::ForRatio(160, 441);
+
+        for (size_t phase = 0; phase < 160; phase++)
+        {
+            double gain = 0;
+            for (size_t tap = 0; tap < filter->TapsPerPhase; tap++)
+            {
+                gain += filter->PhaseTaps[phase * filter->TapsPerPhase + tap];
+            }
+
+            QVERIFY(std::abs(gain - 1.0) < 0.01);
+        }
+    }
+
+    void CachesFilterPerRatio()
+    {
+        QVERIFY(ResamplerFilter::ForRatio(1, 3) == ResamplerFilter::ForRatio(1, 3));
+        QVERIFY(ResamplerFilter::ForRatio(1, 3) != ResamplerFilter::ForRatio(2, 3));
+    }
+
+    void KeepsPassbandAndRejectsAliases()
+    {
+        const size_t inputRate = 48000;
+        const size_t framesCount = inputRate;
+
+        StreamResampler passband, alias;
+        passband.Configure(inputRate, TEST_TARGET_RATE, 1);
+        alias.Configure(inputRate, TEST_TARGET_RATE, 1);
+
+        // 12 kHz is above the 8 kHz Nyquist frequency of the output and would fold to 4 kHz
+        auto passbandRms = SettledRms(Resample(passband, Tone(framesCount, 1000, inputRate), framesCount));
+        auto aliasRms = SettledRms(Resample(alias, Tone(framesCount, 12000, inputRate), framesCount));
+
+        QVERIFY(std::abs(passbandRms - 0.5 / std::sqrt(2.0)) < 0.01);
+        QVERIFY(20 * std::log10(aliasRms / passbandRms) < -RESAMPLER_STOPBAND_DB + 10);
+    }
+
+    void ChunkedInputMatchesWhole()
+    {
+        auto input = Tone(44100, 440, 44100);
+
+        StreamResampler whole, chunked;
+        whole.Configure(44100, TEST_TARGET_RATE, 1);
+        chunked.Configure(44100, TEST_TARGET_RATE, 1);
+
+        auto wholeOutput = Resample(whole, input, input.size());
+        auto chunkedOutput = Resample(chunked, input, 333);
+
+        QCOMPARE(chunkedOutput.size(), wholeOutput.size());
+        QVERIFY(chunkedOutput == wholeOutput);
+    }
+
+    void DownmixesChannels()
+    {
+        StreamResampler resampler;
+        resampler.Configure(TEST_TARGET_RATE, TEST_TARGET_RATE, 2);
+
+        const float interleaved[] = { 1.0f, 0.0f, 0.5f, 0.5f, -1.0f, 1.0f };
+        float mono[3];
+
+        QCOMPARE(resampler.Process(interleaved, 3, mono), static_cast<size_t>(3));
+        QVERIFY(mono[0] == 0.5f && mono[1] == 0.5f && mono[2] == 0.0f);
+    }
+};
+
+QTEST_APPLESS_MAIN(StreamResamplerTest)
+
+#include "StreamResamplerTest.moc"
@@ -0,0 +1,94 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <chrono>
+#include <thread>
+
+#include <QtTest>
+
+#include "API/Session/TokenBucket.h"
+
+using namespace dePhonica::Core::Api;
+
+class TokenBucketTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ZeroRateIsUnlimited()
+    {
+        TokenBucket bucket;
+
+        QVERIFY(bucket.IsLimited() == false);
+
+        for (int n = 0; n < 1000; n++)
+        {
+            QVERIFY(bucket.TryTake());
+        }
+    }
+
+    void AllowsBurstThenRefuses()
+    {
+        // One token per second does not refill a whole token while the test runs
+        TokenBucket bucket(1, 5);
+
+        for (int n = 0; n < 5; n++)
+        {
+            QVERIFY(bucket.TryTake());
+        }
+
+        QVERIFY(bucket.TryTake() == false);
+        QVERIFY(bucket.Tokens() < 1);
+    }
+
+    void BurstCoversOneSecondOfRate()
+    {
+        TokenBucket bucket(10, 2);
+
+        QVERIFY(bucket.TryTake(10));
+        QVERIFY(bucket.TryTake() == false);
+    }
+
+    void TakesSeveralTokensAtOnce()
+    {
+        TokenBucket bucket(1, 5);
+
+        QVERIFY(bucket.TryTake(6) == false);
+        QVERIFY(bucket.TryTake(4));
+        QVERIFY(bucket.TryTake(2) == false);
+        QVERIFY(bucket.TryTake(1));
+    }
+
+    void RefillsWithTime()
+    {
+        TokenBucket bucket(20);
+
+        QVERIFY(bucket.TryTake(20));
+        QVERIFY(bucket.TryTake() == false);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        QVERIFY(bucket.TryTake());
+    }
+
+    void RefillStopsAtBurst()
+    {
+        TokenBucket bucket(1000, 5);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        QCOMPARE(bucket.Tokens(), 1000.0);
+        QVERIFY(bucket.TryTake(1000));
+        QVERIFY(bucket.TryTake(1000) == false);
+    }
+};
+
+QTEST_APPLESS_MAIN(TokenBucketTest)
+
+#include "TokenBucketTest.moc"
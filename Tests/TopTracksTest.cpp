@@ -0,0 +1,134 @@
+/****
+  This file is part of Audio Search Service
+
+  Copyright 2020 Max Klimenko <info@dephonica.com> for dePhonica sound labs.
+
+  NOTICE:  All information contained herein is, and remains the property of dePhonica sound labs
+           and its contragents mentioned in related agreements, if any.
+****/
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <QtTest>
+
+#include "API/Search/TopTracks.h"
+
+using namespace dePhonica::Core::Api;
+
+class TopTracksTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    static LutResult Result(uint32_t trackIndex, uint32_t chunkIndex, uint32_t catches)
+    {
+        LutResult result;
+        result.TrackIndex = trackIndex;
+        result.ChunkIndex = chunkIndex;
+        result.Catches = catches;
+        return result;
+    }
+
+    static std::vector<LutResult> RandomResults(size_t count, uint32_t seed)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<uint32_t> catches(0, 40);
+
+        std::vector<LutResult> results;
+        for (size_t n = 0; n < count; n++)
+        {
+            results.push_back(Result(static_cast<uint32_t>(n), static_cast<uint32_t>(n % 7), catches(generator)));
+        }
+
+        std::shuffle(results.begin(), results.end(), generator);
+        return results;
+    }
+
+    static std::vector<LutResult> SortedPrefix(std::vector<LutResult> results, size_t k)
+    {
+        std::sort(results.begin(), results.end(), TopTracks::IsBetter);
+        results.resize(std::min(k, results.size()));
+        return results;
+    }
+
+    static bool IsSame(const std::vector<LutResult>& a, const std::vector<LutResult>& b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const LutResult& x, const LutResult& y) {
+            return x.TrackIndex == y.TrackIndex && x.ChunkIndex == y.ChunkIndex && x.Catches == y.Catches;
+        });
+    }
+
+private slots:
+    void SelectKeepsBestFirst()
+    {
+        auto results = RandomResults(5000, 1);
+
+        QVERIFY(IsSame(TopTracks::Select(results, 100), SortedPrefix(results, 100)));
+        QVERIFY(IsSame(TopTracks::Select(results, 10000), SortedPrefix(results, 10000)));
+        QVERIFY(TopTracks::Select(results, 0).empty());
+    }
+
+    void SelectBreaksTiesByTrack()
+    {
+        std::vector<LutResult> results = { Result(7, 0, 5), Result(3, 0, 5), Result(9, 0, 6), Result(1, 0, 5) };
+        auto selected = TopTracks::Select(results, 3);
+
+        QCOMPARE(selected.size(), static_cast<size_t>(3));
+        QVERIFY(selected[0].TrackIndex == 9);
+        QVERIFY(selected[1].TrackIndex == 1);
+        QVERIFY(selected[2].TrackIndex == 3);
+    }
+
+    void SelectCountsAllResults()
+    {
+        auto results = RandomResults(3000, 2);
+
+        std::vector<LutResult> selected;
+        CatchHistogram histogram;
+        TopTracks::Select(results, 5, selected, &histogram);
+
+        CatchHistogram expected;
+        for (const auto& result : results)
+        {
+            expected.resize(std::max<size_t>(expected.size(), static_cast<size_t>(result.Catches) + 1));
+            expected[result.Catches]++;
+        }
+
+        QCOMPARE(selected.size(), static_cast<size_t>(5));
+        QVERIFY(histogram == expected);
+    }
+
+    void MergeKeepsBestFirst()
+    {
+        auto results = RandomResults(4000, 3);
+
+        std::vector<std::vector<LutResult>> partialResults(4);
+        for (size_t n = 0; n < results.size(); n++)
+        {
+            partialResults[n % partialResults.size()].push_back(results[n]);
+        }
+
+        for (auto& partialResult : partialResults)
+        {
+            partialResult = TopTracks::Select(partialResult, 50);
+        }
+
+        partialResults.push_back({});
+
+        QVERIFY(IsSame(TopTracks::Merge(partialResults, 50), SortedPrefix(results, 50)));
+    }
+
+    void AddHistogramGrowsTotal()
+    {
+        CatchHistogram total = { 1, 2 };
+        TopTracks::AddHistogram({ 3, 0, 4 }, total);
+
+        QVERIFY(total == CatchHistogram({ 4, 2, 4 }));
+    }
+};
+
+QTEST_APPLESS_MAIN(TopTracksTest)
+
+#include "TopTracksTest.moc"
@@ -10,9 +10,12 @@
 #ifndef VERSIONAPIMODEL_H
 #define VERSIONAPIMODEL_H
 
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QString>
 
+#include "API/Dsp/Kernels.h"
+
 namespace dePhonica::Core::Api {
 
 class VersionApiModel
@@ -29,8 +32,23 @@ public:
         return { { "ProductName", ProductName },
                  { "SoftwareVersion", SoftwareVersion },
                  { "HardwareVersion", HardwareVersion },
+                 { "Kernels", KernelsToJson() },
                  { "result", "ok" } };
     }
+
+private:
+    // The kernel variant chosen for this CPU and the state of every compiled variant
+    static QJsonObject KernelsToJson()
+    {
+        QJsonArray variants;
+        for (const auto& variant : Kernels::Variants())
+        {
+            variants.append(QJsonObject(
+                { { "name", variant.Name }, { "supported", variant.IsSupported }, { "verified", variant.IsVerified } }));
+        }
+
+        return { { "active", Kernels::Active().Name }, { "variants", variants } };
+    }
 };
 
 } // namespace dePhonica::Core::Api
@@ -31,11 +31,11 @@ public:
 
     QHttpServerRequest::Method MethodsImplemented() override { return QHttpServerRequest::Method::Get; }
 
-    QJsonObject Get(const QHttpServerRequest&, const QStringList&) override { return versionModel_.ToJson(); }
+    QJsonObject Get(const QHttpServerRequest&, const RouteArguments&) override { return versionModel_.ToJson(); }
 
-    QJsonObject Post(const QHttpServerRequest&, const QStringList&) override { return QJsonObject(); }
-    QJsonObject Put(const QHttpServerRequest&, const QStringList&) override { return QJsonObject(); }
-    QJsonObject Delete(const QHttpServerRequest&, const QStringList&) override { return QJsonObject(); }
+    QJsonObject Post(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Put(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
+    QJsonObject Delete(const QHttpServerRequest&, const RouteArguments&) override { return QJsonObject(); }
 };
 
 } // namespace dePhonica::Core::Api